@@ -0,0 +1,145 @@
+/*
+ * Driver for the FUZZ targets in uiu_ums.c when libFuzzer is not at hand
+ * (gcc, MSVC).  It replays every file named on the command line (folders
+ * are read one level deep), then runs FUZZ_ITERS (default 0) inputs made
+ * by small random edits of those files: bit flips, byte sets, inserts,
+ * deletes and truncation.  Build together with a sanitizer so a bad read
+ * stops the run:
+ *
+ *   gcc -DFUZZ=FUZZ_LZ -fsanitize=address,undefined ../../uiu_ums.c replay.c
+ *
+ * Each input is echoed before it runs, so the last one printed is the
+ * culprit; mutated inputs are saved to crash-input first.
+ */
+#define _DEFAULT_SOURCE
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+typedef struct
+{
+    uint8_t *p;
+    size_t n;
+} Input;
+
+static Input *g_in;
+static int g_nIn, g_capIn;
+
+static void add_file(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return;
+    Input in = {NULL, 0};
+    size_t cap = 0;
+    int c;
+    while ((c = fgetc(fp)) != EOF)
+    {
+        if (in.n == cap)
+        {
+            cap = cap ? cap * 2 : 256;
+            in.p = (uint8_t *)realloc(in.p, cap);
+        }
+        in.p[in.n++] = (uint8_t)c;
+    }
+    fclose(fp);
+    if (g_nIn == g_capIn)
+    {
+        g_capIn = g_capIn ? g_capIn * 2 : 16;
+        g_in = (Input *)realloc(g_in, (size_t)g_capIn * sizeof(Input));
+    }
+    g_in[g_nIn++] = in;
+    printf("replay %s (%zu bytes)\n", path, in.n);
+    fflush(stdout);
+    LLVMFuzzerTestOneInput(in.p ? in.p : (const uint8_t *)"", in.n);
+}
+
+static void add_path(const char *path)
+{
+    DIR *d = opendir(path);
+    if (!d)
+    {
+        add_file(path);
+        return;
+    }
+    struct dirent *e;
+    char sub[4096];
+    while ((e = readdir(d)) != NULL)
+        if (e->d_name[0] != '.')
+        {
+            snprintf(sub, sizeof(sub), "%s/%s", path, e->d_name);
+            add_file(sub);
+        }
+    closedir(d);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+        add_path(argv[i]);
+    long iters = getenv("FUZZ_ITERS") ? atol(getenv("FUZZ_ITERS")) : 0;
+    if (!g_nIn || iters <= 0)
+        return 0;
+    srand(getenv("FUZZ_SEED") ? (unsigned)atol(getenv("FUZZ_SEED")) : 1u);
+    uint8_t *buf = NULL;
+    size_t cap = 0;
+    for (long it = 0; it < iters; it++)
+    {
+        const Input *src = &g_in[rand() % g_nIn];
+        size_t n = src->n;
+        if (cap < n + 64)
+            buf = (uint8_t *)realloc(buf, cap = n + 64);
+        if (n)
+            memcpy(buf, src->p, n);
+        for (int edits = 1 + rand() % 4; edits > 0; edits--)
+        {
+            size_t at = n ? (size_t)rand() % n : 0;
+            switch (rand() % 5)
+            {
+            case 0:
+                if (n)
+                    buf[at] ^= (uint8_t)(1u << (rand() % 8));
+                break;
+            case 1:
+                if (n)
+                    buf[at] = (uint8_t)(rand() % 4 == 0 ? 0xFF : rand());
+                break;
+            case 2:
+                if (n + 1 < cap)
+                {
+                    memmove(buf + at + 1, buf + at, n - at);
+                    buf[at] = (uint8_t)rand();
+                    n++;
+                }
+                break;
+            case 3:
+                if (n)
+                {
+                    memmove(buf + at, buf + at + 1, n - at - 1);
+                    n--;
+                }
+                break;
+            default:
+                n = at;
+            }
+        }
+        FILE *fp = fopen("crash-input", "wb");
+        if (fp)
+        {
+            fwrite(buf, 1, n, fp);
+            fclose(fp);
+        }
+        LLVMFuzzerTestOneInput(buf, n);
+    }
+    remove("crash-input");
+    free(buf);
+    for (int i = 0; i < g_nIn; i++)
+        free(g_in[i].p);
+    free(g_in);
+    printf("%ld mutated inputs ok\n", iters);
+    return 0;
+}
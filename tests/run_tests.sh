@@ -0,0 +1,168 @@
+#!/bin/sh
+# Golden-dataset and performance checks for uiu_ums.c.
+#
+#   tests/run_tests.sh            build, run both suites
+#   tests/run_tests.sh golden     functional suite only
+#   tests/run_tests.sh perf       performance suite only
+#   tests/run_tests.sh update     rewrite golden/expected.txt from this build
+#
+# The golden suite seeds a fresh data folder from golden/ (courses through
+# Admin > Add Course, the CSVs through Admin > Bulk Import), replays
+# golden/requests.txt through --serve and diffs the answers, with timings
+# removed, against golden/expected.txt.  Lines starting with '#' in the
+# request file are comments.  It covers transcripts and CGPA
+# math, rosters, leaderboards, co-enrollment, grade writes and enrollments.
+#
+# The perf suite generates PERF_STUDENTS students (5 enrollments each over
+# 50 courses x 10 terms, so every roster has PERF_STUDENTS / 100 rows),
+# times the hot paths through --serve and checks the median of each
+# against perf_budgets.txt.  Results are kept per commit in
+# results/<commit>.txt.  Exit status is non-zero on any failure.
+#
+# CC and CFLAGS pick the compiler (tests/Makefile passes sanitizer flags).
+
+set -u
+HERE=$(cd "$(dirname "$0")" && pwd)
+SRC="$HERE/../uiu_ums.c"
+WORK=${WORK:-"$HERE/_work"}
+BIN="$WORK/uiu_ums"
+PERF_STUDENTS=${PERF_STUDENTS:-20000}
+PERF_RUNS=${PERF_RUNS:-5}
+MODE=${1:-all}
+FAILED=0
+
+rm -rf "$WORK"
+mkdir -p "$WORK" || exit 1
+${CC:-gcc} ${CFLAGS:--std=c11 -O2} -o "$BIN" "$SRC" || exit 1
+
+# seed DIR COURSES_FILE STUDENTS_CSV ENROLLMENTS_CSV [GRADES_CSV]
+# Logs in as the bootstrap admin, adds the courses, bulk-imports the CSVs.
+# The menu loop never ends on its own, so the reader stops at the logout.
+seed()
+{
+    dir=$1
+    mkdir -p "$dir"
+    {
+        printf 'admin\nadmin123\n'
+        grep -v '^#' "$2" | awk -F'|' '{ printf "6\n%s\n%s\n%s\n%s\n%s\n", $1, $2, $3, $4, $5 }'
+        printf '19\n1\n%s\n' "$3"
+        printf '19\n2\n%s\n' "$4"
+        [ -n "${5:-}" ] && printf '19\n3\n%s\n' "$5"
+        printf '0\n'
+    } > "$dir/seed.in"
+    (cd "$dir" && "$BIN" < seed.in 2>&1 | sed -n '/Logged out\./q;p' > seed.log)
+    want=$(grep -c '^19$' "$dir/seed.in")
+    good=$(grep -c 'Imported .* 0 rejected' "$dir/seed.log")
+    [ "$good" -eq "$want" ] && return 0
+    echo "seeding $dir failed:"
+    grep -E 'Imported|Stopped|line [0-9]+:' "$dir/seed.log"
+    return 1
+}
+
+# Drop what varies between runs: timings and the latency table at exit
+normalize()
+{
+    sed -e 's/ (wait [0-9.]* ms, run [0-9.]* ms)$//' -e '/^class  *weight/,$d'
+}
+
+golden()
+{
+    dir="$WORK/golden"
+    seed "$dir" "$HERE/golden/courses.txt" "$HERE/golden/students.csv" "$HERE/golden/enrollments.csv" \
+        "$HERE/golden/grades.csv" || return 1
+    # one server per request: a shared queue would reorder them (fair
+    # queuing), and the checks depend on writes landing before later reads
+    grep -v '^#' "$HERE/golden/requests.txt" | while IFS= read -r req; do
+        echo "> $req"
+        (cd "$dir" && echo "$req" | "$BIN" --serve 2>&1) | normalize | sed '1,/^Serving /d'
+    done > "$dir/actual.txt"
+    if [ "$MODE" = update ]; then
+        cp "$dir/actual.txt" "$HERE/golden/expected.txt"
+        echo "golden: expected.txt updated"
+        return 0
+    fi
+    if diff -u "$HERE/golden/expected.txt" "$dir/actual.txt"; then
+        echo "golden: ok ($(grep -c '^> ' "$dir/actual.txt") requests)"
+    else
+        echo "golden: FAILED"
+        return 1
+    fi
+}
+
+# Median of the "run R ms" timings of one command in a --serve log
+median_run()
+{
+    grep " ok $2 (" "$1" | sed 's/.*run \([0-9.]*\) ms)$/\1/' | sort -n |
+        awk '{ v[NR] = $1 } END { print NR ? v[int((NR + 1) / 2)] : -1 }'
+}
+
+perf()
+{
+    dir="$WORK/perf"
+    mkdir -p "$dir"
+    awk 'BEGIN { for (c = 0; c < 50; c++) printf "PRF-%04d|Perf Course %d|3|PRF|FAC-EEE-001\n", c, c }' \
+        > "$dir/courses.txt"
+    awk -v n="$PERF_STUDENTS" 'BEGIN {
+        for (i = 0; i < n; i++)
+            printf "3%010d,Perf Student %d,PRF,241,p%d@example.com\n", i, i, i }' > "$dir/students.csv"
+    awk -v n="$PERF_STUDENTS" 'BEGIN {
+        split("A A- B+ B B- C+ C C- D F", g, " ")
+        for (i = 0; i < n; i++)
+            for (k = 0; k < 5; k++)
+                printf "3%010d,PRF-%04d,Term-%02d,%s\n", i, (i + k * 7) % 50, int(i / 5) % 10, g[(i * 3 + k) % 10 + 1]
+    }' > "$dir/grades.csv"
+    cut -d, -f1-3 "$dir/grades.csv" > "$dir/enrollments.csv"
+    seed "$dir" "$dir/courses.txt" "$dir/students.csv" "$dir/enrollments.csv" "$dir/grades.csv" || return 1
+
+    # one warm-up pass (builds the adjacency index), then PERF_RUNS timed ones
+    r=0
+    while [ "$r" -le "$PERF_RUNS" ]; do
+        c=$((r * 7 % 50))
+        printf 'roster PRF-%04d Term-%02d\n' "$c" $((r % 10))
+        printf 'transcript %011d\n' $((30000000000 + r * 997))
+        printf 'leaderboard Term-%02d\n' $((r % 10))
+        printf 'related PRF-%04d Term-%02d\n' "$c" $((r % 10))
+        printf 'grade %011d PRF-%04d Term-%02d B\n' $((30000000000 + r * 5)) $((r * 5 % 50)) $((r % 10))
+        printf 'enroll %011d PRF-%04d Term-%02d\n' $((30000000000 + r)) $(((r + 1) % 50)) 99
+        r=$((r + 1))
+    done > "$dir/requests.txt"
+    (cd "$dir" && "$BIN" --serve < requests.txt > serve.log 2>&1)
+
+    rev=$(git -C "$HERE" rev-parse --short HEAD 2>/dev/null || echo unknown)
+    mkdir -p "$HERE/results"
+    out="$HERE/results/$rev.txt"
+    {
+        echo "# $(date '+%Y-%m-%d %H:%M') students=$PERF_STUDENTS enrollments=$((PERF_STUDENTS * 5)) runs=$PERF_RUNS"
+        printf '%-12s %10s %10s  %s\n' op median_ms budget_ms result
+        secs=$(sed -n 's/.*Imported grades: .*(\([0-9.]*\) s)$/\1/p' "$dir/seed.log")
+        echo "bulk_grades $secs" | awk '{ printf "%-12s %10.2f", $1, $2 * 1000 }'
+        grep -v '^#' "$HERE/perf_budgets.txt" | awk '$1 == "bulk_grades" { print $2 }' |
+            awk -v s="$secs" '{ ms = s * 1000; printf " %10s  %s\n", $1, ms <= $1 ? "ok" : "OVER" }'
+        for op in roster transcript leaderboard related grade enroll; do
+            m=$(median_run "$dir/serve.log" "$op")
+            b=$(awk -v op="$op" '$1 == op { print $2 }' "$HERE/perf_budgets.txt")
+            awk -v op="$op" -v m="$m" -v b="$b" 'BEGIN {
+                printf "%-12s %10.2f %10s  %s\n", op, m, b, (m >= 0 && m <= b) ? "ok" : "OVER" }'
+        done
+    } > "$out"
+    cat "$out"
+    if grep -q 'OVER$' "$out"; then
+        echo "perf: FAILED (results in tests/results/$rev.txt)"
+        return 1
+    fi
+    echo "perf: ok (results in tests/results/$rev.txt)"
+}
+
+case "$MODE" in
+golden | update) golden || FAILED=1 ;;
+perf) perf || FAILED=1 ;;
+all)
+    golden || FAILED=1
+    perf || FAILED=1
+    ;;
+*)
+    echo "usage: $0 [all|golden|perf|update]"
+    exit 2
+    ;;
+esac
+exit $FAILED
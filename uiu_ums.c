@@ -12,10 +12,20 @@
  * FEATURES
  * - User roles: ADMIN, FACULTY, STUDENT (simple login system).
  * - Entities: Students, Faculty, Courses, Enrollments (grades).
- * - Admin: CRUD students/faculty/courses, enroll, assign grades, reports.
+ * - Admin: CRUD students/faculty/courses, enroll, assign grades, reports,
+ *   resumable CSV bulk import of students, enrollments and grades, and
+ *   migration of the Learner program's student_records.txt.
  * - Faculty: View courses, class rosters, enter/update grades.
- * - Student: View profile, enrollments, transcript, GPA.
+ * - Student: View profile, enrollments, transcript, GPA; register via a course cart.
+ * - Tracing: per-action spans to a Chrome trace file and a slow-operation log.
+ * - Settings: uiu_ums.conf (reloaded on SIGHUP), shown by Admin > System Stats.
+ * - Campuses: one process can serve several data roots (uiu_ums NAME=DIR ...).
+ * - Export: batch transcript rendering to HTML and PDF from cached templates.
+ * - Server mode: uiu_ums --serve takes line requests on stdin with priority
+ *   classes and bounded queues (see SERVER MODE).
  * - Storage: Binary files (simple, portable), created on first run with demo data.
+ *   Per-student/per-course enrollment lists are kept in enrollments.adj,
+ *   per-student views in snapshots/, closed terms compressed in archive/.
  *
  * SECURITY NOTE
  * - This is a teaching project. Passwords are lightly obfuscated (XOR + salt).
@@ -24,13 +34,38 @@
  */
 
 #define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, MADV_HUGEPAGE
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <signal.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <sys/stat.h>
+#define MKDIR(p) _mkdir(p)
+#define FSYNC(fp) _commit(_fileno(fp))
+#define TRUNCATE(fp, len) _chsize(_fileno(fp), (long)(len))
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <poll.h>
+#define MKDIR(p) mkdir(p, 0755)
+#define FSYNC(fp) fsync(fileno(fp))
+#define TRUNCATE(fp, len) ftruncate(fileno(fp), (off_t)(len))
+#endif
 
-/* ======== CONFIG ======== */
+/* ======== CONFIG ========
+ * Field sizes below fix the on-disk record layout and stay compile-time.
+ * Everything tunable lives in g_cfg, loaded from uiu_ums.conf (see SETTINGS).
+ */
 #define MAX_NAME 64
 #define MAX_DEPT 32
 #define MAX_EMAIL 64
@@ -41,11 +76,92 @@
 #define MAX_USER 32
 #define MAX_PASS 32
 
-#define FILE_STUD "students.dat"
-#define FILE_FAC "faculty.dat"
-#define FILE_COURSE "courses.dat"
-#define FILE_ENR "enrollments.dat"
-#define FILE_USER "users.dat"
+#define MAX_PATH_LEN 256
+#define COENR_MAX_TERMS 8 // co-enrollment cache slots compiled in
+#define REPORT_CACHE_SLOTS 64 // cached report results compiled in
+#define CART_MAX 12            // courses per registration cart
+
+typedef struct
+{
+    char dataDir[MAX_PATH_LEN - 32]; // default campus root
+    long tenantMemQuotaMb;           // parked cache budget per campus
+    long tenantIdleSecs;             // drop parked caches after this long
+    long coenrollTerms;              // co-enrollment terms kept cached
+    long leaderboardMax;             // students per leaderboard
+    long enrIndex;                   // ENR_INDEX_*
+    long fsyncPolicy;                // FSYNC_*
+    char traceFile[MAX_PATH_LEN - 32]; // Chrome trace-event JSON, empty = off
+    char slowLog[MAX_PATH_LEN - 32];   // slow-operation log, empty = off
+    long slowOpMs;                     // slow-log threshold (busy time)
+    long traceRedact;                  // mask student IDs in span arguments
+    long hugePages;                    // HUGE_PAGES_* for large in-memory tables
+    long reportCacheEntries;           // cached transcripts/leaderboards, 0 = off
+    long courseCapacity;               // seats per course and term, 0 = unlimited
+    long serveQueueDepth;              // --serve: queued requests per priority class
+    long studentSnapshots;             // serve student views from snapshots/
+    long zoneMaps;                     // prune enrollment scans by block summaries
+    long bulkBatch;                    // bulk import rows per commit + checkpoint
+    long indexBuildRows;               // secondary-index backfill rows per idle step, 0 = off
+    long memBudgetMb;                  // all caches/indexes/buffers together, 0 = unlimited
+    long rosterSnapshotSecs;           // faculty roster snapshot refresh interval, 0 = live reads
+} Config;
+
+enum
+{
+    ENR_INDEX_ADJACENCY,
+    ENR_INDEX_SCAN
+};
+enum
+{
+    FSYNC_NONE,
+    FSYNC_ALWAYS
+};
+enum
+{
+    HUGE_PAGES_OFF,
+    HUGE_PAGES_TRANSPARENT,
+    HUGE_PAGES_EXPLICIT
+};
+
+static Config g_cfg = {".", 64, 600, COENR_MAX_TERMS, 2048, ENR_INDEX_ADJACENCY, FSYNC_NONE,
+                       "", "slowops.log", 500, 1, HUGE_PAGES_TRANSPARENT,
+                       REPORT_CACHE_SLOTS, 0, 256, 1, 1, 1000, 4096, 1024, 60};
+
+/* Data files live under the active campus (tenant) root; see TENANTS */
+typedef enum
+{
+    TF_STUD,
+    TF_FAC,
+    TF_COURSE,
+    TF_ENR,
+    TF_USER,
+    TF_ADJ,  // derived: per-student / per-course enrollment lists
+    TF_SNAP, // derived: per-student snapshot directory
+    TF_ARCHIVE,  // closed-term segments (see TERM ARCHIVE)
+    TF_ARCH_CAT, // list of archived terms
+    TF_ZONES,    // derived: per-block summaries of enrollments.dat
+    TF_BULK,     // checkpoint of an unfinished bulk import
+    TF_COUNT
+} TenantFile;
+
+static const char *TENANT_FILE_NAMES[TF_COUNT] = {
+    "students.dat", "faculty.dat", "courses.dat", "enrollments.dat", "users.dat", "enrollments.adj", "snapshots",
+    "archive",      "archive.cat", "enrollments.zmp", "bulk.ckpt"};
+
+static char g_dataFiles[TF_COUNT][MAX_PATH_LEN]; // paths for the active tenant
+static long g_fileEpoch[TF_COUNT];               // in-place rewrites (file_write_at), parked per tenant
+
+#define FILE_STUD g_dataFiles[TF_STUD]
+#define FILE_FAC g_dataFiles[TF_FAC]
+#define FILE_COURSE g_dataFiles[TF_COURSE]
+#define FILE_ENR g_dataFiles[TF_ENR]
+#define FILE_USER g_dataFiles[TF_USER]
+#define FILE_ADJ g_dataFiles[TF_ADJ]
+#define FILE_SNAP g_dataFiles[TF_SNAP]
+#define FILE_ARCHIVE g_dataFiles[TF_ARCHIVE]
+#define FILE_ARCH_CAT g_dataFiles[TF_ARCH_CAT]
+#define FILE_ZONES g_dataFiles[TF_ZONES]
+#define FILE_BULK_CKPT g_dataFiles[TF_BULK]
 
 /* ======== TYPES ======== */
 typedef enum
@@ -135,11 +251,37 @@ void trim_newline(char *s)
         s[n - 1] = 0;
 }
 
+/* Monotonic wall clock in microseconds */
+double now_us()
+{
+#ifdef _WIN32
+    return (double)clock() * 1e6 / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+#endif
+}
+
+static double g_inputWaitUs; // time spent blocked on the keyboard (see TRACING)
+
 void read_line(const char *prompt, char *buf, size_t cap)
 {
     printf("%s", prompt);
-    if (fgets(buf, (int)cap, stdin))
+    double t0 = now_us();
+    int got = fgets(buf, (int)cap, stdin) != NULL;
+    g_inputWaitUs += now_us() - t0;
+    if (got)
     {
+        size_t n = strlen(buf);
+        if (n + 1 == cap && buf[n - 1] != '\n')
+        {
+            // overlong input: drop the rest so it doesn't feed the next prompt
+            int c;
+            while ((c = getchar()) != '\n' && c != EOF)
+            {
+            }
+        }
         trim_newline(buf);
     }
     else
@@ -149,18 +291,43 @@ void read_line(const char *prompt, char *buf, size_t cap)
     }
 }
 
+/* Whole-string integer parse; 0 on junk, trailing text or overflow */
+int parse_int(const char *s, int *out)
+{
+    char *end;
+    while (isspace((unsigned char)*s))
+        s++;
+    if (!*s)
+        return 0;
+    long v = strtol(s, &end, 10);
+    while (isspace((unsigned char)*end))
+        end++;
+    if (*end || v < -2147483647L || v > 2147483647L)
+        return 0;
+    *out = (int)v;
+    return 1;
+}
+
+/* Returns -1 for anything that is not a plain integer */
 int read_int(const char *prompt)
 {
     char line[64];
+    int v;
     read_line(prompt, line, sizeof(line));
-    return atoi(line);
+    return parse_int(line, &v) ? v : -1;
 }
 
+/* Returns -1 for anything that is not a finite number */
 float read_float(const char *prompt)
 {
-    char line[64];
+    char line[64], *end;
     read_line(prompt, line, sizeof(line));
-    return (float)atof(line);
+    double v = strtod(line, &end);
+    while (isspace((unsigned char)*end))
+        end++;
+    if (end == line || *end || !(v > -1e30 && v < 1e30))
+        return -1.0f;
+    return (float)v;
 }
 
 void upper(char *s)
@@ -169,11 +336,263 @@ void upper(char *s)
         *s = (char)toupper((unsigned char)*s);
 }
 
+/* Growable output buffer used by the renderers */
+typedef struct
+{
+    char *p;
+    size_t n, cap;
+} StrBuf;
+
+void sb_put(StrBuf *b, const char *s, size_t len)
+{
+    if (b->n + len + 1 > b->cap)
+    {
+        size_t cap = b->cap ? b->cap : 1024;
+        while (b->n + len + 1 > cap)
+            cap *= 2;
+        char *p = (char *)realloc(b->p, cap);
+        if (!p)
+            return;
+        b->p = p;
+        b->cap = cap;
+    }
+    memcpy(b->p + b->n, s, len);
+    b->n += len;
+    b->p[b->n] = 0;
+}
+
+void sb_puts(StrBuf *b, const char *s)
+{
+    sb_put(b, s, strlen(s));
+}
+
+void sb_printf(StrBuf *b, const char *fmt, ...)
+{
+    char tmp[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (len > 0)
+        sb_put(b, tmp, (size_t)len < sizeof(tmp) ? (size_t)len : sizeof(tmp) - 1);
+}
+
+void sb_free(StrBuf *b)
+{
+    free(b->p);
+    b->p = NULL;
+    b->n = b->cap = 0;
+}
+
+/* Make a record ID safe to use as a file name */
+void safe_filename(const char *in, char *out, size_t cap)
+{
+    size_t i = 0;
+    for (; in[i] && i + 1 < cap; i++)
+        out[i] = (isalnum((unsigned char)in[i]) || in[i] == '-' || in[i] == '_') ? in[i] : '_';
+    out[i] = 0;
+}
+
+/* safe_filename, but distinct inputs never share a name: when sanitizing
+ * changed anything (or truncated), a hash of the raw input is appended.
+ * '~' never survives sanitizing, so suffixed names cannot meet clean ones. */
+void unique_filename(const char *in, char *out, size_t cap)
+{
+    safe_filename(in, out, cap);
+    if (strcmp(in, out) == 0)
+        return;
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (const char *s = in; *s; s++)
+        h = (h ^ (unsigned char)*s) * 1099511628211ull;
+    char sfx[18];
+    snprintf(sfx, sizeof(sfx), "~%016llx", (unsigned long long)h);
+    size_t keep = strlen(out);
+    if (keep + sizeof(sfx) > cap)
+        keep = cap > sizeof(sfx) ? cap - sizeof(sfx) : 0;
+    snprintf(out + keep, cap - keep, "%s", sfx);
+}
+
+/* ======== TRACING ========
+ * Spans wrap each menu action and each storage call.  A span records its
+ * arguments (student IDs masked when trace_redact = on), records scanned,
+ * bytes read or written, and wall time.  Keyboard wait inside a span is
+ * tracked separately so "busy" time is what gets compared to slow_op_ms;
+ * slow spans go to slow_log.  With trace_file set every span is also
+ * written as a Chrome trace-event ("ph":"X"), viewable in chrome://tracing
+ * or Perfetto.  The file is an unterminated JSON array, which both accept.
+ */
+#define TRACE_MAX_DEPTH 16
+
+typedef struct
+{
+    const char *cat, *op;
+    char args[160];
+    double t0, wait0;
+    long rows, bytes;
+} Span;
+
+static Span g_spans[TRACE_MAX_DEPTH];
+static int g_spanDepth;
+static double g_traceEpoch;
+static FILE *g_traceFp;
+static char g_traceOpenPath[MAX_PATH_LEN];
+static int g_traceCampus = 1; // Chrome "pid" lane: one per campus
+static const char *g_traceCampusName = "default";
+
+/* Masked copy of a student ID for span arguments (rotating buffers) */
+const char *redact_id(const char *id)
+{
+    static char bufs[4][MAX_ID];
+    static int next;
+    char *b = bufs[next++ % 4];
+    snprintf(b, MAX_ID, "%s", id);
+    size_t n = strlen(b);
+    if (g_cfg.traceRedact)
+        for (size_t i = 0; i + 3 < n; i++)
+            b[i] = '*';
+    return b;
+}
+
+void trace_begin(const char *cat, const char *op, const char *fmt, ...)
+{
+    if (g_spanDepth >= TRACE_MAX_DEPTH)
+    {
+        g_spanDepth++; // keep begin/end balanced, just don't record
+        return;
+    }
+    Span *sp = &g_spans[g_spanDepth++];
+    sp->cat = cat;
+    sp->op = op;
+    sp->args[0] = 0;
+    if (fmt)
+    {
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(sp->args, sizeof(sp->args), fmt, ap);
+        va_end(ap);
+    }
+    sp->rows = sp->bytes = 0;
+    sp->wait0 = g_inputWaitUs;
+    sp->t0 = now_us();
+    if (g_traceEpoch == 0)
+        g_traceEpoch = sp->t0;
+}
+
+/* Append arguments to the innermost open span */
+void trace_args(const char *fmt, ...)
+{
+    if (g_spanDepth < 1 || g_spanDepth > TRACE_MAX_DEPTH)
+        return;
+    Span *sp = &g_spans[g_spanDepth - 1];
+    size_t len = strlen(sp->args);
+    if (len && len + 1 < sizeof(sp->args))
+        sp->args[len++] = ' ';
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(sp->args + len, sizeof(sp->args) - len, fmt, ap);
+    va_end(ap);
+}
+
+/* Count records and bytes against the innermost span */
+void trace_io(long rows, long bytes)
+{
+    if (g_spanDepth < 1 || g_spanDepth > TRACE_MAX_DEPTH)
+        return;
+    g_spans[g_spanDepth - 1].rows += rows;
+    g_spans[g_spanDepth - 1].bytes += bytes;
+}
+
+void json_escaped(FILE *fp, const char *s)
+{
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', fp);
+        if ((unsigned char)*s >= 0x20)
+            fputc(*s, fp);
+    }
+}
+
+FILE *trace_file()
+{
+    if (!g_cfg.traceFile[0])
+    {
+        if (g_traceFp)
+            fclose(g_traceFp);
+        g_traceFp = NULL;
+        return NULL;
+    }
+    if (g_traceFp && strcmp(g_traceOpenPath, g_cfg.traceFile) == 0)
+        return g_traceFp;
+    if (g_traceFp)
+        fclose(g_traceFp);
+    g_traceFp = fopen(g_cfg.traceFile, "a");
+    if (!g_traceFp)
+        return NULL;
+    snprintf(g_traceOpenPath, sizeof(g_traceOpenPath), "%s", g_cfg.traceFile);
+    if (ftell(g_traceFp) == 0)
+        fputs("[\n", g_traceFp);
+    return g_traceFp;
+}
+
+void trace_end()
+{
+    if (g_spanDepth < 1)
+        return;
+    if (g_spanDepth-- > TRACE_MAX_DEPTH)
+        return;
+    Span *sp = &g_spans[g_spanDepth];
+    double dur = now_us() - sp->t0;
+    double wait = g_inputWaitUs - sp->wait0;
+    double busy = dur - wait;
+    if (g_spanDepth > 0)
+    {
+        g_spans[g_spanDepth - 1].rows += sp->rows;
+        g_spans[g_spanDepth - 1].bytes += sp->bytes;
+    }
+    FILE *fp = trace_file();
+    if (fp)
+    {
+        fprintf(fp, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.0f,\"dur\":%.0f,\"pid\":%d,\"tid\":1,"
+                    "\"args\":{\"args\":\"",
+                sp->op, sp->cat, sp->t0 - g_traceEpoch, dur, g_traceCampus);
+        json_escaped(fp, sp->args);
+        fprintf(fp, "\",\"rows\":%ld,\"bytes\":%ld,\"input_wait_us\":%.0f}},\n", sp->rows, sp->bytes, wait);
+        if (g_spanDepth == 0)
+            fflush(fp);
+    }
+    if (g_cfg.slowOpMs > 0 && g_cfg.slowLog[0] && busy >= g_cfg.slowOpMs * 1000.0)
+    {
+        FILE *sl = fopen(g_cfg.slowLog, "a");
+        if (sl)
+        {
+            char when[32];
+            time_t now = time(NULL);
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&now));
+            fprintf(sl, "%s campus=%s op=%s/%s busy_ms=%.1f rows=%ld bytes=%ld args=[%s]\n", when,
+                    g_traceCampusName, sp->cat, sp->op, busy / 1000.0, sp->rows, sp->bytes, sp->args);
+            fclose(sl);
+        }
+    }
+}
+
 /* ======== FILE HELPERS ======== */
 #define OPEN_BIN_APPEND(path, fp) FILE *fp = fopen(path, "ab")
 #define OPEN_BIN_READ(path, fp) FILE *fp = fopen(path, "rb")
 #define OPEN_BIN_WRITE(path, fp) FILE *fp = fopen(path, "wb")
 
+/* Modification time in ns (whole seconds on Windows), 0 if missing */
+int64_t file_mtime(const char *path)
+{
+#ifdef _WIN32
+    struct _stat st;
+    return _stat(path, &st) == 0 ? (int64_t)st.st_mtime * 1000000000 : 0;
+#else
+    struct stat st;
+    return stat(path, &st) == 0 ? (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec : 0;
+#endif
+}
+
 /* Count records of size recSize in file */
 long file_count_records(const char *path, size_t recSize)
 {
@@ -194,23 +613,25 @@ long file_find_first(const char *path, size_t recSize, rec_pred pred, const void
     OPEN_BIN_READ(path, fp);
     if (!fp)
         return -1;
-    long idx = 0;
+    trace_begin("storage", "file_find_first", "%s", path);
+    long idx = 0, found = -1;
     unsigned char *buf = (unsigned char *)malloc(recSize);
     while (fread(buf, recSize, 1, fp) == 1)
     {
+        idx++;
         if (pred(buf, key))
         {
             if (out)
                 memcpy(out, buf, recSize);
-            free(buf);
-            fclose(fp);
-            return idx;
+            found = idx - 1;
+            break;
         }
-        idx++;
     }
     free(buf);
     fclose(fp);
-    return -1;
+    trace_io(idx, idx * (long)recSize);
+    trace_end();
+    return found;
 }
 
 int file_read_at(const char *path, size_t recSize, long index, void *out)
@@ -218,13 +639,11 @@ int file_read_at(const char *path, size_t recSize, long index, void *out)
     OPEN_BIN_READ(path, fp);
     if (!fp)
         return 0;
-    if (fseek(fp, index * recSize, SEEK_SET) != 0)
-    {
-        fclose(fp);
-        return 0;
-    }
-    int ok = fread(out, recSize, 1, fp) == 1;
+    trace_begin("storage", "file_read_at", "%s #%ld", path, index);
+    int ok = fseek(fp, index * recSize, SEEK_SET) == 0 && fread(out, recSize, 1, fp) == 1;
     fclose(fp);
+    trace_io(ok, ok ? (long)recSize : 0);
+    trace_end();
     return ok;
 }
 
@@ -237,14 +656,17 @@ int file_write_at(const char *path, size_t recSize, long index, const void *rec)
     FILE *fp = fopen(path, "rb+");
     if (!fp)
         return 0;
-    if (fseek(fp, index * recSize, SEEK_SET) != 0)
-    {
-        fclose(fp);
-        return 0;
-    }
-    int ok = fwrite(rec, recSize, 1, fp) == 1;
+    trace_begin("storage", "file_write_at", "%s #%ld", path, index);
+    int ok = fseek(fp, index * recSize, SEEK_SET) == 0 && fwrite(rec, recSize, 1, fp) == 1;
     fflush(fp);
+    if (ok && g_cfg.fsyncPolicy == FSYNC_ALWAYS)
+        FSYNC(fp);
     fclose(fp);
+    for (int f = 0; ok && f < TF_COUNT; f++)
+        if (strcmp(path, g_dataFiles[f]) == 0)
+            g_fileEpoch[f]++; // see SECONDARY INDEXES
+    trace_io(ok, ok ? (long)recSize : 0);
+    trace_end();
     return ok;
 }
 
@@ -253,12 +675,301 @@ int file_append(const char *path, size_t recSize, const void *rec)
     OPEN_BIN_APPEND(path, fp);
     if (!fp)
         return 0;
+    trace_begin("storage", "file_append", "%s", path);
     int ok = fwrite(rec, recSize, 1, fp) == 1;
     fflush(fp);
+    if (g_cfg.fsyncPolicy == FSYNC_ALWAYS)
+        FSYNC(fp);
+    fclose(fp);
+    trace_io(ok, ok ? (long)recSize : 0);
+    trace_end();
+    return ok;
+}
+
+/* Append n records with one write; on failure the file is cut back so
+ * either all of them land or none do. */
+int file_append_batch(const char *path, size_t recSize, const void *recs, size_t n)
+{
+    OPEN_BIN_APPEND(path, fp);
+    if (!fp)
+        return 0;
+    trace_begin("storage", "file_append_batch", "%s n=%zu", path, n);
+    fseek(fp, 0, SEEK_END);
+    long start = ftell(fp);
+    int ok = start >= 0 && fwrite(recs, recSize, n, fp) == n;
+    ok = fflush(fp) == 0 && ok;
+    if (ok && g_cfg.fsyncPolicy == FSYNC_ALWAYS)
+        ok = FSYNC(fp) == 0;
+    if (!ok && start >= 0 && TRUNCATE(fp, start) != 0)
+        printf("[storage] %s: could not roll back a partial batch\n", path);
     fclose(fp);
+    trace_io(ok ? (long)n : 0, ok ? (long)(n * recSize) : 0);
+    trace_end();
     return ok;
 }
 
+/* Read every record of a file into one malloc'd array (NULL when empty/missing) */
+void *file_load_all(const char *path, size_t recSize, long *count)
+{
+    *count = 0;
+    long n = file_count_records(path, recSize);
+    if (n <= 0)
+        return NULL;
+    OPEN_BIN_READ(path, fp);
+    if (!fp)
+        return NULL;
+    void *arr = malloc((size_t)n * recSize);
+    if (!arr)
+    {
+        fclose(fp);
+        return NULL;
+    }
+    trace_begin("storage", "file_load_all", "%s", path);
+    *count = (long)fread(arr, recSize, (size_t)n, fp);
+    fclose(fp);
+    trace_io(*count, *count * (long)recSize);
+    trace_end();
+    return arr;
+}
+
+/* ======== SETTINGS ========
+ * uiu_ums.conf (or --config=PATH): "key = value" lines, '#' comments.
+ * Invalid values are reported and the previous value is kept.  SIGHUP
+ * re-reads the file; keys marked cold only take effect after a restart.
+ */
+typedef enum
+{
+    CFG_LONG,
+    CFG_CHOICE,
+    CFG_PATH
+} CfgType;
+
+typedef struct
+{
+    const char *key;
+    CfgType type;
+    size_t offset;
+    long min, max;       // CFG_LONG range; CFG_PATH: min = required, max = buffer size
+    const char *choices; // CFG_CHOICE: '|' separated, value = position
+    int hot;             // safe to change while running
+} CfgKey;
+
+static const CfgKey CFG_KEYS[] = {
+    {"data_dir", CFG_PATH, offsetof(Config, dataDir), 1, sizeof(((Config *)0)->dataDir), NULL, 0},
+    {"tenant_mem_quota_mb", CFG_LONG, offsetof(Config, tenantMemQuotaMb), 1, 65536, NULL, 1},
+    {"tenant_idle_secs", CFG_LONG, offsetof(Config, tenantIdleSecs), 10, 86400 * 7, NULL, 1},
+    {"coenroll_terms", CFG_LONG, offsetof(Config, coenrollTerms), 1, COENR_MAX_TERMS, NULL, 1},
+    {"leaderboard_max", CFG_LONG, offsetof(Config, leaderboardMax), 1, 1000000, NULL, 1},
+    {"enrollment_index", CFG_CHOICE, offsetof(Config, enrIndex), 0, 0, "adjacency|scan", 1},
+    {"fsync", CFG_CHOICE, offsetof(Config, fsyncPolicy), 0, 0, "none|always", 1},
+    {"trace_file", CFG_PATH, offsetof(Config, traceFile), 0, sizeof(((Config *)0)->traceFile), NULL, 1},
+    {"slow_log", CFG_PATH, offsetof(Config, slowLog), 0, sizeof(((Config *)0)->slowLog), NULL, 1},
+    {"slow_op_ms", CFG_LONG, offsetof(Config, slowOpMs), 0, 3600000, NULL, 1},
+    {"trace_redact", CFG_CHOICE, offsetof(Config, traceRedact), 0, 0, "off|on", 1},
+    {"huge_pages", CFG_CHOICE, offsetof(Config, hugePages), 0, 0, "off|transparent|explicit", 1},
+    {"report_cache_entries", CFG_LONG, offsetof(Config, reportCacheEntries), 0, REPORT_CACHE_SLOTS, NULL, 1},
+    {"course_capacity", CFG_LONG, offsetof(Config, courseCapacity), 0, 100000, NULL, 1},
+    {"serve_queue_depth", CFG_LONG, offsetof(Config, serveQueueDepth), 1, 1000000, NULL, 0},
+    {"student_snapshots", CFG_CHOICE, offsetof(Config, studentSnapshots), 0, 0, "off|on", 1},
+    {"zone_maps", CFG_CHOICE, offsetof(Config, zoneMaps), 0, 0, "off|on", 1},
+    {"bulk_batch", CFG_LONG, offsetof(Config, bulkBatch), 1, 1000000, NULL, 1},
+    {"index_build_rows", CFG_LONG, offsetof(Config, indexBuildRows), 0, 10000000, NULL, 1},
+    {"memory_budget_mb", CFG_LONG, offsetof(Config, memBudgetMb), 0, 1048576, NULL, 1},
+    {"roster_snapshot_secs", CFG_LONG, offsetof(Config, rosterSnapshotSecs), 0, 86400, NULL, 1},
+};
+#define CFG_KEY_COUNT (int)(sizeof(CFG_KEYS) / sizeof(CFG_KEYS[0]))
+
+static char g_cfgPath[MAX_PATH_LEN] = "uiu_ums.conf";
+static volatile sig_atomic_t g_cfgReload;
+static unsigned long g_cfgGen; // bumped whenever a reload changes a setting
+
+char *trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1]))
+        *--e = 0;
+    return s;
+}
+
+/* Position of word in a '|' separated list, or -1 */
+int choice_index(const char *choices, const char *word)
+{
+    size_t len = strlen(word);
+    for (int i = 0; *choices; i++)
+    {
+        const char *bar = strchr(choices, '|');
+        size_t n = bar ? (size_t)(bar - choices) : strlen(choices);
+        if (n == len && strncmp(choices, word, n) == 0)
+            return i;
+        if (!bar)
+            break;
+        choices = bar + 1;
+    }
+    return -1;
+}
+
+int cfg_set(Config *c, const CfgKey *k, const char *val)
+{
+    char *field = (char *)c + k->offset;
+    if (k->type == CFG_PATH)
+    {
+        if ((k->min && !val[0]) || strlen(val) >= (size_t)k->max)
+            return 0;
+        strcpy(field, val);
+        return 1;
+    }
+    long v;
+    if (k->type == CFG_CHOICE)
+        v = choice_index(k->choices, val);
+    else
+    {
+        char *end;
+        v = strtol(val, &end, 10);
+        if (end == val || *end || v < k->min || v > k->max)
+            return 0;
+    }
+    if (v < 0)
+        return 0;
+    *(long *)field = v;
+    return 1;
+}
+
+void cfg_format(const Config *c, const CfgKey *k, char *out, size_t cap)
+{
+    const char *field = (const char *)c + k->offset;
+    if (k->type == CFG_PATH)
+        snprintf(out, cap, "%s", field);
+    else if (k->type == CFG_LONG)
+        snprintf(out, cap, "%ld", *(const long *)field);
+    else
+    {
+        const char *p = k->choices;
+        for (long i = *(const long *)field; i > 0 && p; i--)
+            p = strchr(p, '|') ? strchr(p, '|') + 1 : NULL;
+        snprintf(out, cap, "%.*s", p ? (int)strcspn(p, "|") : 1, p ? p : "?");
+    }
+}
+
+/* Parse the settings file into *c (missing file = keep defaults) */
+int config_load(Config *c, const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+    char line[512];
+    int lineNo = 0;
+    while (fgets(line, sizeof(line), fp))
+    {
+        lineNo++;
+        if (!strchr(line, '\n') && !feof(fp))
+        {
+            int c;
+            while ((c = fgetc(fp)) != '\n' && c != EOF)
+            {
+            }
+            printf("%s:%d: line too long, ignored\n", path, lineNo);
+            continue;
+        }
+        line[strcspn(line, "#")] = 0;
+        char *eq = strchr(line, '=');
+        char *key = trim(line);
+        if (!*key)
+            continue;
+        if (!eq)
+        {
+            printf("%s:%d: expected key = value\n", path, lineNo);
+            continue;
+        }
+        *eq = 0;
+        key = trim(key);
+        char *val = trim(eq + 1);
+        int i = 0;
+        while (i < CFG_KEY_COUNT && strcmp(CFG_KEYS[i].key, key) != 0)
+            i++;
+        if (i == CFG_KEY_COUNT)
+            printf("%s:%d: unknown setting '%s'\n", path, lineNo, key);
+        else if (!cfg_set(c, &CFG_KEYS[i], val))
+            printf("%s:%d: invalid value '%s' for %s\n", path, lineNo, val, key);
+    }
+    fclose(fp);
+    return 1;
+}
+
+void on_sighup(int sig)
+{
+    (void)sig;
+    g_cfgReload = 1;
+}
+
+/* Apply a pending SIGHUP reload; cold keys keep their running value */
+void config_poll()
+{
+    if (!g_cfgReload)
+        return;
+    g_cfgReload = 0;
+    Config next = g_cfg;
+    if (!config_load(&next, g_cfgPath))
+    {
+        printf("[config] %s not readable, keeping current settings\n", g_cfgPath);
+        return;
+    }
+    for (int i = 0; i < CFG_KEY_COUNT; i++)
+    {
+        const CfgKey *k = &CFG_KEYS[i];
+        char was[MAX_PATH_LEN], now[MAX_PATH_LEN];
+        cfg_format(&g_cfg, k, was, sizeof(was));
+        cfg_format(&next, k, now, sizeof(now));
+        if (strcmp(was, now) == 0)
+            continue;
+        if (k->hot)
+        {
+            printf("[config] %s: %s -> %s\n", k->key, was, now);
+            g_cfgGen++;
+        }
+        else
+        {
+            printf("[config] %s change needs a restart (keeping %s)\n", k->key, was);
+            memcpy((char *)&next + k->offset, (const char *)&g_cfg + k->offset,
+                   k->type == CFG_PATH ? (size_t)k->max : sizeof(long));
+        }
+    }
+    g_cfg = next;
+}
+
+void config_init(int *argc, char **argv)
+{
+    // strip a leading --config=PATH so the remaining args are campuses
+    if (*argc > 1 && strncmp(argv[1], "--config=", 9) == 0)
+    {
+        snprintf(g_cfgPath, sizeof(g_cfgPath), "%s", argv[1] + 9);
+        for (int i = 1; i + 1 < *argc; i++)
+            argv[i] = argv[i + 1];
+        (*argc)--;
+    }
+    config_load(&g_cfg, g_cfgPath);
+#ifndef _WIN32
+    // SA_RESTART: a reload must not abort the prompt the user is typing at
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sighup;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGHUP, &sa, NULL);
+#endif
+}
+
+void config_print()
+{
+    char val[MAX_PATH_LEN];
+    printf("Settings (%s):\n", g_cfgPath);
+    for (int i = 0; i < CFG_KEY_COUNT; i++)
+    {
+        cfg_format(&g_cfg, &CFG_KEYS[i], val, sizeof(val));
+        printf("  %-20s = %s%s\n", CFG_KEYS[i].key, val, CFG_KEYS[i].hot ? "" : "  (restart to change)");
+    }
+}
+
 /* ======== PREDICATES ======== */
 int pred_student_by_id(const void *rec, const void *key)
 {
@@ -297,426 +1008,5151 @@ int pred_enr_by_key(const void *rec, const void *key)
     return strcmp(e->studentId, k->sid) == 0 && strcmp(e->courseCode, k->code) == 0 && strcmp(e->term, k->term) == 0;
 }
 
-/* ======== DOMAIN LOGIC ======== */
-float grade_to_points(const char *g)
+/* ======== LARGE ALLOCATIONS ========
+ * Adjacency lists and co-enrollment matrices are probed at random (binary
+ * search, matrix rows), so with millions of enrollments TLB misses dominate.
+ * Blocks of at least BIG_MIN_BYTES are mapped 2 MB aligned and either
+ * advised for transparent huge pages or, with huge_pages=explicit, taken
+ * from the hugetlb pool (falling back to transparent when it is empty).
+ * Smaller blocks, huge_pages=off and non-Linux builds use malloc.  Every
+ * block carries a header so big_realloc/big_free need no size argument.
+ */
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define BIG_MIN_BYTES (HUGE_PAGE_SIZE / 2)
+
+typedef struct
 {
-    // UIU-like 4.0 scale (adjust if your dept uses different)
-    // Supports A, A-, B+, B, B-, C+, C, C-, D, F
-    if (strcmp(g, "A") == 0)
-        return 4.00f;
-    if (strcmp(g, "A-") == 0)
-        return 3.70f;
-    if (strcmp(g, "B+") == 0)
-        return 3.30f;
-    if (strcmp(g, "B") == 0)
-        return 3.00f;
-    if (strcmp(g, "B-") == 0)
-        return 2.70f;
-    if (strcmp(g, "C+") == 0)
-        return 2.30f;
-    if (strcmp(g, "C") == 0)
-        return 2.00f;
-    if (strcmp(g, "C-") == 0)
-        return 1.70f;
-    if (strcmp(g, "D") == 0)
-        return 1.00f;
-    if (strcmp(g, "F") == 0)
-        return 0.00f;
-    return -1.0f; // invalid
-}
+    size_t size;   // usable bytes requested
+    size_t mapLen; // mapping length, 0 = malloc'd
+    int huge;      // HUGE_PAGES_* actually obtained
+    char pad[64 - 2 * sizeof(size_t) - sizeof(int)];
+} BigHdr; // 64 bytes: keeps the payload cache-line (and AVX) aligned
 
-void print_student(const Student *s)
+static struct
 {
-    printf("ID: %s | Name: %s | Dept: %s | Batch: %d | Email: %s\n", s->id, s->name, s->dept, s->batch, s->email);
-}
+    long blocks, mapped, hugetlb; // live blocks by kind
+    size_t mappedBytes;
+} g_big;
 
-void print_faculty(const Faculty *f)
+static int g_memPressure; // over memory_budget_mb recently; see MEMORY BUDGET
+
+#ifdef __linux__
+/* Map len bytes (multiple of HUGE_PAGE_SIZE) on a huge-page boundary */
+void *big_map(size_t len, int *huge)
 {
-    printf("ID: %s | Name: %s | Dept: %s | Email: %s\n", f->id, f->name, f->dept, f->email);
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (g_cfg.hugePages == HUGE_PAGES_EXPLICIT)
+    {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            *huge = HUGE_PAGES_EXPLICIT;
+            return p;
+        }
+    }
+#endif
+    // over-map by one huge page and trim so the start is 2 MB aligned
+    char *raw = (char *)mmap(NULL, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+    char *start = (char *)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (start > raw)
+        munmap(raw, (size_t)(start - raw));
+    munmap(start + len, (size_t)(raw + HUGE_PAGE_SIZE - start));
+#ifdef MADV_HUGEPAGE
+    madvise(start, len, MADV_HUGEPAGE);
+#endif
+    *huge = HUGE_PAGES_TRANSPARENT;
+    return start;
 }
+#endif
 
-void print_course(const Course *c)
+void *big_alloc(size_t n)
 {
-    printf("Code: %s | Title: %s | Credit: %.1f | Dept: %s | Instructor: %s\n",
-           c->code, c->title, c->credit, c->dept, c->instructorId);
+    BigHdr *h = NULL;
+    size_t need = sizeof(BigHdr) + (n ? n : 1);
+#ifdef __linux__
+    if (g_cfg.hugePages != HUGE_PAGES_OFF && n >= BIG_MIN_BYTES)
+    {
+        size_t len = (need + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        int huge = HUGE_PAGES_OFF;
+        h = (BigHdr *)big_map(len, &huge);
+        if (h)
+        {
+            h->mapLen = len;
+            h->huge = huge;
+            g_big.mapped++;
+            g_big.hugetlb += huge == HUGE_PAGES_EXPLICIT;
+            g_big.mappedBytes += len;
+        }
+    }
+#endif
+    if (!h)
+    {
+        h = (BigHdr *)malloc(need);
+        if (!h)
+            return NULL;
+        h->mapLen = 0;
+        h->huge = HUGE_PAGES_OFF;
+    }
+    h->size = n;
+    g_big.blocks++;
+    return h + 1;
 }
 
-void print_enr(const Enrollment *e)
+void *big_calloc(size_t n)
 {
-    printf("Student: %s | Course: %s | Term: %s | Grade: %s\n", e->studentId, e->courseCode, e->term, e->grade);
+    void *p = big_alloc(n);
+    if (p && !((BigHdr *)p - 1)->mapLen) // fresh mappings are already zero
+        memset(p, 0, n);
+    return p;
 }
 
-/* ======== CRUD ======== */
-void add_student()
+void big_free(void *p)
 {
-    Student s = {0};
-    read_line("Student ID: ", s.id, sizeof(s.id));
-    if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, s.id, NULL) >= 0)
+    if (!p)
+        return;
+    BigHdr *h = (BigHdr *)p - 1;
+    g_big.blocks--;
+#ifdef __linux__
+    if (h->mapLen)
     {
-        printf("Student with this ID already exists.\n");
+        g_big.mapped--;
+        g_big.hugetlb -= h->huge == HUGE_PAGES_EXPLICIT;
+        g_big.mappedBytes -= h->mapLen;
+        munmap(h, h->mapLen);
         return;
     }
-    read_line("Name: ", s.name, sizeof(s.name));
-    read_line("Dept (EEE/CSE...): ", s.dept, sizeof(s.dept));
-    s.batch = read_int("Batch (e.g., 241): ");
-    read_line("Email: ", s.email, sizeof(s.email));
+#endif
+    free(h);
+}
+
+/* Like realloc; grows in place while the mapping has room */
+void *big_realloc(void *p, size_t n)
+{
+    if (!p)
+        return big_alloc(n);
+    BigHdr *h = (BigHdr *)p - 1;
+    if (h->mapLen && sizeof(BigHdr) + n <= h->mapLen)
+    {
+        h->size = n;
+        return p;
+    }
+    if (!h->mapLen && n < BIG_MIN_BYTES)
+    {
+        BigHdr *nh = (BigHdr *)realloc(h, sizeof(BigHdr) + (n ? n : 1));
+        if (!nh)
+            return NULL;
+        nh->size = n;
+        return nh + 1;
+    }
+    void *q = big_alloc(n);
+    if (!q)
+        return NULL;
+    memcpy(q, p, h->size < n ? h->size : n);
+    big_free(p);
+    return q;
+}
+
+/* ======== SECONDARY INDEXES ========
+ * Sorted (key, record number) arrays over fields that the other indexes
+ * do not cover: students by dept, courses by instructor, enrollments by
+ * term.  They are built in the background, so adding one to a large table
+ * never blocks a request:
+ *
+ *   1. backfill: the builder takes the current record count as its
+ *      snapshot and reads up to index_build_rows records per idle point
+ *      (menu loop tops, the server between requests and when idle) into
+ *      a shadow array;
+ *   2. catch up: records appended meanwhile are read from the tail;
+ *   3. switch: the shadow is sorted and becomes the live index.
+ *
+ * The data files only grow at the end, except for in-place rewrites
+ * through file_write_at, which bump the file's epoch.  An index whose key
+ * can change in place (dept, instructor) restarts when the epoch moved
+ * during a build, and a live one is retired and rebuilt.  Grade writes
+ * never touch a term, so they do not matter to the term index.  Until an
+ * index is live, queries use their old scan; appends after the switch are
+ * folded in on the next lookup.  index_build_rows = 0 turns building off;
+ * memory pressure (see MEMORY BUDGET) pauses it.
+ */
+#define IDX_KEY 32 // longest indexed field (dept)
+
+typedef struct
+{
+    char key[IDX_KEY];
+    int32_t ref; // record number in the data file
+} IdxEntry;
+
+enum
+{
+    IDX_STUDENT_DEPT,
+    IDX_COURSE_INSTRUCTOR,
+    IDX_ENROLLMENT_TERM,
+    IDX_COUNT
+};
+
+enum
+{
+    IDX_EMPTY,
+    IDX_BUILDING,
+    IDX_READY
+};
+
+typedef struct
+{
+    int state;
+    IdxEntry *live; // sorted by key, then ref; valid when IDX_READY
+    int32_t nLive, capLive, nRecs; // nRecs: data records covered
+    IdxEntry *shadow;              // being built
+    int32_t nShadow, capShadow, pos, target;
+    long startEpoch;
+    double buildUs;          // busy time of the current/last build
+    long builds, restarts, hits;
+} SecIndex;
+
+static SecIndex g_idx[IDX_COUNT];
+
+void idx_key_dept(const void *rec, char *out)
+{
+    snprintf(out, IDX_KEY, "%s", ((const Student *)rec)->dept);
+}
+
+void idx_key_instructor(const void *rec, char *out)
+{
+    snprintf(out, IDX_KEY, "%s", ((const Course *)rec)->instructorId);
+}
+
+void idx_key_term(const void *rec, char *out)
+{
+    snprintf(out, IDX_KEY, "%s", ((const Enrollment *)rec)->term);
+}
+
+static const struct
+{
+    const char *name;
+    int file;       // TenantFile
+    size_t recSize;
+    int keyMutable; // key can change through file_write_at
+    void (*key)(const void *rec, char *out);
+} IDX_DEFS[IDX_COUNT] = {
+    {"students.dept", TF_STUD, sizeof(Student), 1, idx_key_dept},
+    {"courses.instructor", TF_COURSE, sizeof(Course), 1, idx_key_instructor},
+    {"enrollments.term", TF_ENR, sizeof(Enrollment), 0, idx_key_term},
+};
+
+int cmp_idx_entry(const void *a, const void *b)
+{
+    const IdxEntry *x = (const IdxEntry *)a, *y = (const IdxEntry *)b;
+    int c = strcmp(x->key, y->key);
+    return c ? c : (x->ref > y->ref) - (x->ref < y->ref);
+}
+
+void sec_index_free(SecIndex *ix)
+{
+    big_free(ix->live);
+    big_free(ix->shadow);
+    memset(ix, 0, sizeof(*ix));
+}
+
+long sec_index_mem_usage(const SecIndex *ix)
+{
+    return ((long)ix->capLive + ix->capShadow) * (long)sizeof(IdxEntry);
+}
+
+/* Append entries for records [from, to) of the index's file to
+ * (*arr, *n, *cap); returns the number of records read, -1 on error */
+long idx_read_range(int i, int32_t from, int32_t to, IdxEntry **arr, int32_t *n, int32_t *cap)
+{
+    const char *path = g_dataFiles[IDX_DEFS[i].file];
+    size_t rs = IDX_DEFS[i].recSize;
+    if (*n + (to - from) > *cap)
+    {
+        int32_t c = *cap ? *cap : 64;
+        while (c < *n + (to - from))
+            c *= 2;
+        IdxEntry *na = (IdxEntry *)big_realloc(*arr, (size_t)c * sizeof(IdxEntry));
+        if (!na)
+            return -1;
+        *arr = na;
+        *cap = c;
+    }
+    OPEN_BIN_READ(path, fp);
+    if (!fp || fseek(fp, (long)from * (long)rs, SEEK_SET) != 0)
+    {
+        if (fp)
+            fclose(fp);
+        return -1;
+    }
+    char rec[sizeof(Student) > sizeof(Course) ? sizeof(Student) : sizeof(Course)];
+    long got = 0;
+    for (int32_t r = from; r < to && fread(rec, rs, 1, fp) == 1; r++, got++)
+    {
+        IdxEntry *e = &(*arr)[(*n)++];
+        IDX_DEFS[i].key(rec, e->key);
+        e->ref = r;
+    }
+    fclose(fp);
+    trace_io(got, got * (long)rs);
+    return got;
+}
+
+void idx_start(int i)
+{
+    SecIndex *ix = &g_idx[i];
+    big_free(ix->shadow);
+    ix->shadow = NULL;
+    ix->nShadow = ix->capShadow = ix->pos = 0;
+    ix->target = (int32_t)file_count_records(g_dataFiles[IDX_DEFS[i].file], IDX_DEFS[i].recSize);
+    ix->startEpoch = g_fileEpoch[IDX_DEFS[i].file];
+    ix->buildUs = 0;
+    if (ix->state != IDX_READY)
+        ix->state = IDX_BUILDING;
+}
+
+/* Fold records appended after the live index was built into it */
+int idx_catch_up(int i, int32_t n)
+{
+    SecIndex *ix = &g_idx[i];
+    int32_t old = ix->nLive;
+    if (idx_read_range(i, ix->nRecs, n, &ix->live, &ix->nLive, &ix->capLive) != n - ix->nRecs)
+        return 0;
+    qsort(ix->live + old, (size_t)(ix->nLive - old), sizeof(IdxEntry), cmp_idx_entry);
+    // merge the sorted tail into the sorted head, back to front
+    IdxEntry *tail = (IdxEntry *)malloc((size_t)(ix->nLive - old) * sizeof(IdxEntry) + 1);
+    if (!tail)
+        return 0;
+    memcpy(tail, ix->live + old, (size_t)(ix->nLive - old) * sizeof(IdxEntry));
+    int32_t a = old - 1, b = ix->nLive - old - 1, w = ix->nLive - 1;
+    while (b >= 0)
+        ix->live[w--] = (a >= 0 && cmp_idx_entry(&ix->live[a], &tail[b]) > 0) ? ix->live[a--] : tail[b--];
+    free(tail);
+    ix->nRecs = n;
+    return 1;
+}
+
+/* Is index i live and current?  Catches up on appends; retires it if a
+ * key may have changed in place or the file shrank. */
+int idx_usable(int i)
+{
+    SecIndex *ix = &g_idx[i];
+    if (ix->state != IDX_READY || !g_cfg.indexBuildRows)
+        return 0;
+    int32_t n = (int32_t)file_count_records(g_dataFiles[IDX_DEFS[i].file], IDX_DEFS[i].recSize);
+    if ((IDX_DEFS[i].keyMutable && g_fileEpoch[IDX_DEFS[i].file] != ix->startEpoch) || n < ix->nRecs ||
+        (n > ix->nRecs && !idx_catch_up(i, n)))
+    {
+        big_free(ix->live);
+        ix->live = NULL;
+        ix->nLive = ix->capLive = ix->nRecs = 0;
+        ix->state = IDX_EMPTY; // the builder starts over
+        return 0;
+    }
+    return 1;
+}
+
+/* Record numbers whose key equals key (sorted ascending), or NULL when the
+ * index is not live: then the caller scans. */
+const IdxEntry *index_range(int i, const char *key, int32_t *count)
+{
+    *count = 0;
+    if (!idx_usable(i))
+        return NULL;
+    SecIndex *ix = &g_idx[i];
+    int32_t lo = 0, hi = ix->nLive;
+    while (lo < hi) // first entry >= key
+    {
+        int32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(ix->live[mid].key, key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int32_t end = lo;
+    while (end < ix->nLive && strcmp(ix->live[end].key, key) == 0)
+        end++;
+    *count = end - lo;
+    ix->hits++;
+    return ix->live + lo;
+}
+
+/* One builder step: up to budget records of backfill or catch-up on the
+ * first index that needs work.  Returns 1 while work remains. */
+int index_build_step(long budget)
+{
+    if (budget <= 0)
+        return 0;
+    for (int i = 0; i < IDX_COUNT; i++)
+    {
+        SecIndex *ix = &g_idx[i];
+        if (ix->state == IDX_READY)
+        {
+            idx_usable(i); // retire if stale, fold in appends
+            if (ix->state == IDX_READY)
+                continue;
+        }
+        if (ix->state == IDX_EMPTY)
+            idx_start(i);
+        double t0 = now_us();
+        trace_begin("index", "index_build_step", "%s %d/%d", IDX_DEFS[i].name, ix->pos, ix->target);
+        int32_t to = ix->pos + (int32_t)(budget < ix->target - ix->pos ? budget : ix->target - ix->pos);
+        int ok = idx_read_range(i, ix->pos, to, &ix->shadow, &ix->nShadow, &ix->capShadow) == to - ix->pos;
+        ix->pos = to;
+        if (ok && ix->pos == ix->target)
+        {
+            // backfill done: catch up on appends made during it, then switch
+            int32_t n = (int32_t)file_count_records(g_dataFiles[IDX_DEFS[i].file], IDX_DEFS[i].recSize);
+            if (n > ix->target)
+                ok = idx_read_range(i, ix->target, n, &ix->shadow, &ix->nShadow, &ix->capShadow) == n - ix->target;
+            if (ok && (n < ix->target ||
+                       (IDX_DEFS[i].keyMutable && g_fileEpoch[IDX_DEFS[i].file] != ix->startEpoch)))
+            {
+                ix->restarts++; // a key may have changed behind the backfill
+                trace_end();
+                idx_start(i);
+                return 1;
+            }
+            if (ok)
+            {
+                if (ix->nShadow) // empty table: no shadow array at all
+                    qsort(ix->shadow, (size_t)ix->nShadow, sizeof(IdxEntry), cmp_idx_entry);
+                big_free(ix->live);
+                ix->live = ix->shadow;
+                ix->nLive = ix->nShadow;
+                ix->capLive = ix->capShadow;
+                ix->nRecs = n;
+                ix->shadow = NULL;
+                ix->nShadow = ix->capShadow = 0;
+                ix->state = IDX_READY;
+                ix->builds++;
+            }
+        }
+        if (!ok)
+        {
+            big_free(ix->shadow); // file vanished or no memory: try again later
+            ix->shadow = NULL;
+            ix->nShadow = ix->capShadow = 0;
+            ix->state = IDX_EMPTY;
+        }
+        ix->buildUs += now_us() - t0;
+        trace_end();
+        return 1;
+    }
+    return 0;
+}
+
+/* Idle-point hook: one throttled step (none while memory is short) */
+int index_idle()
+{
+    return g_memPressure ? 0 : index_build_step(g_cfg.indexBuildRows);
+}
+
+void index_stats()
+{
+    for (int i = 0; i < IDX_COUNT; i++)
+    {
+        const SecIndex *ix = &g_idx[i];
+        printf("Index %-19s ", IDX_DEFS[i].name);
+        if (!g_cfg.indexBuildRows)
+            printf("off\n");
+        else if (ix->state == IDX_READY)
+            printf("live: %d records, %.1f KB, built in %.1f ms, %ld lookups\n", ix->nRecs,
+                   sec_index_mem_usage(ix) / 1024.0, ix->buildUs / 1000.0, ix->hits);
+        else if (ix->state == IDX_BUILDING)
+            printf("%s: %d of %d records (%.0f%%), %ld restarts\n",
+                   g_memPressure ? "paused under memory pressure" : "building", ix->pos, ix->target,
+                   ix->target ? 100.0 * ix->pos / ix->target : 100.0, ix->restarts);
+        else
+            printf("%s\n", g_memPressure ? "paused under memory pressure" : "not yet scheduled");
+    }
+}
+
+/* ======== ZONE MAPS ========
+ * Per-block summaries of enrollments.dat, one per ZONE_BLOCK records:
+ * min/max of term, course code and student ID, plus small Bloom filters
+ * over terms and codes.  A filtered scan (enr_scan) reads only blocks
+ * whose summary admits the filter, so a term or course whose rows are
+ * clustered skips most of the file.  Appends extend the last block in
+ * place.  Updates only ever rewrite grades, which are not summarized;
+ * anything else that changes the file (archiving, another process) shows
+ * up as a record-count mismatch and triggers a rebuild.  The summaries are
+ * saved to enrollments.zmp next to the data.
+ */
+#define ZONE_BLOCK 4096
+#define ZONE_MAGIC 0x504D5A55u // "UZMP"
+#define ZONE_VERSION 1
+#define ZONE_TERM_BITS 256
+#define ZONE_CODE_BITS 1024
+
+typedef struct
+{
+    char minTerm[MAX_TERM], maxTerm[MAX_TERM];
+    char minCode[MAX_CODE], maxCode[MAX_CODE];
+    char minSid[MAX_ID], maxSid[MAX_ID];
+    uint64_t termBloom[ZONE_TERM_BITS / 64];
+    uint64_t codeBloom[ZONE_CODE_BITS / 64];
+    int32_t n; // records summarized
+} Zone;
+
+typedef struct
+{
+    int built, dirty;
+    int32_t nEnr, nZones, cap;
+    Zone *z;
+    long scanned, skipped; // blocks, for System Stats
+} ZoneSet;
+
+static ZoneSet g_zones;
+
+uint64_t zone_hash(const char *s)
+{
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 1099511628211ull;
+    return h;
+}
+
+/* Two probes from one hash (double hashing) */
+void bloom_add(uint64_t *bits, unsigned nbits, const char *s)
+{
+    uint64_t h = zone_hash(s);
+    for (int k = 0; k < 2; k++, h = (h >> 32) | (h << 32))
+        bits[(h % nbits) / 64] |= 1ull << (h % nbits % 64);
+}
+
+int bloom_may_have(const uint64_t *bits, unsigned nbits, const char *s)
+{
+    uint64_t h = zone_hash(s);
+    for (int k = 0; k < 2; k++, h = (h >> 32) | (h << 32))
+        if (!(bits[(h % nbits) / 64] & (1ull << (h % nbits % 64))))
+            return 0;
+    return 1;
+}
+
+void zone_minmax(char *lo, char *hi, const char *v, size_t cap, int first)
+{
+    if (first || strcmp(v, lo) < 0)
+        snprintf(lo, cap, "%s", v);
+    if (first || strcmp(v, hi) > 0)
+        snprintf(hi, cap, "%s", v);
+}
+
+void zone_add(Zone *z, const Enrollment *e)
+{
+    int first = z->n == 0;
+    zone_minmax(z->minTerm, z->maxTerm, e->term, MAX_TERM, first);
+    zone_minmax(z->minCode, z->maxCode, e->courseCode, MAX_CODE, first);
+    zone_minmax(z->minSid, z->maxSid, e->studentId, MAX_ID, first);
+    bloom_add(z->termBloom, ZONE_TERM_BITS, e->term);
+    bloom_add(z->codeBloom, ZONE_CODE_BITS, e->courseCode);
+    z->n++;
+}
+
+/* NULL filters match anything */
+int zone_may_match(const Zone *z, const char *term, const char *code, const char *sid)
+{
+    if (term && (strcmp(term, z->minTerm) < 0 || strcmp(term, z->maxTerm) > 0 ||
+                 !bloom_may_have(z->termBloom, ZONE_TERM_BITS, term)))
+        return 0;
+    if (code && (strcmp(code, z->minCode) < 0 || strcmp(code, z->maxCode) > 0 ||
+                 !bloom_may_have(z->codeBloom, ZONE_CODE_BITS, code)))
+        return 0;
+    if (sid && (strcmp(sid, z->minSid) < 0 || strcmp(sid, z->maxSid) > 0))
+        return 0;
+    return 1;
+}
+
+void zone_set_free(ZoneSet *zs)
+{
+    free(zs->z);
+    memset(zs, 0, sizeof(*zs));
+}
+
+long zone_mem_usage(const ZoneSet *zs)
+{
+    return (long)zs->cap * (long)sizeof(Zone);
+}
+
+/* Summarize one more record (record number nEnr) */
+int zone_push(ZoneSet *zs, const Enrollment *e)
+{
+    if (zs->nZones == 0 || zs->z[zs->nZones - 1].n == ZONE_BLOCK)
+    {
+        if (zs->nZones == zs->cap)
+        {
+            int32_t cap = zs->cap ? zs->cap * 2 : 16;
+            Zone *nz = (Zone *)realloc(zs->z, (size_t)cap * sizeof(Zone));
+            if (!nz)
+                return 0;
+            zs->z = nz;
+            zs->cap = cap;
+        }
+        memset(&zs->z[zs->nZones++], 0, sizeof(Zone));
+    }
+    zone_add(&zs->z[zs->nZones - 1], e);
+    zs->nEnr++;
+    zs->dirty = 1;
+    return 1;
+}
+
+int zone_save_as(ZoneSet *zs, const char *path)
+{
+    OPEN_BIN_WRITE(path, fp);
+    if (!fp)
+        return 0;
+    uint32_t hdr[2] = {ZONE_MAGIC, ZONE_VERSION};
+    int ok = fwrite(hdr, sizeof(hdr), 1, fp) == 1 && fwrite(&zs->nEnr, sizeof(int32_t), 1, fp) == 1 &&
+             fwrite(&zs->nZones, sizeof(int32_t), 1, fp) == 1 &&
+             fwrite(zs->z, sizeof(Zone), (size_t)zs->nZones, fp) == (size_t)zs->nZones;
+    if (fclose(fp) != 0)
+        ok = 0;
+    if (ok)
+        zs->dirty = 0;
+    return ok;
+}
+
+int zone_save(ZoneSet *zs)
+{
+    return zone_save_as(zs, FILE_ZONES);
+}
+
+int zone_load(ZoneSet *zs, long nEnr)
+{
+    OPEN_BIN_READ(FILE_ZONES, fp);
+    if (!fp)
+        return 0;
+    uint32_t hdr[2];
+    int32_t n = 0, nz = 0;
+    int ok = fread(hdr, sizeof(hdr), 1, fp) == 1 && hdr[0] == ZONE_MAGIC && hdr[1] == ZONE_VERSION &&
+             fread(&n, sizeof(int32_t), 1, fp) == 1 && n == nEnr && fread(&nz, sizeof(int32_t), 1, fp) == 1 &&
+             nz == (n + ZONE_BLOCK - 1) / ZONE_BLOCK;
+    zone_set_free(zs);
+    if (ok && nz > 0)
+    {
+        zs->z = (Zone *)malloc((size_t)nz * sizeof(Zone));
+        ok = zs->z && fread(zs->z, sizeof(Zone), (size_t)nz, fp) == (size_t)nz;
+        zs->cap = ok ? nz : 0;
+    }
+    fclose(fp);
+    for (int32_t i = 0; ok && i < nz; i++) // every block full except the last
+        ok = zs->z[i].n == (i + 1 < nz ? ZONE_BLOCK : n - i * ZONE_BLOCK);
+    if (!ok)
+    {
+        zone_set_free(zs);
+        return 0;
+    }
+    zs->nEnr = n;
+    zs->nZones = nz;
+    zs->built = 1;
+    return 1;
+}
+
+/* Make g_zones cover enrollments.dat: load, catch up on appends, or rebuild */
+ZoneSet *zone_ensure()
+{
+    long n = file_count_records(FILE_ENR, sizeof(Enrollment));
+    if (g_zones.built && g_zones.nEnr == n)
+        return &g_zones;
+    if (!g_zones.built || g_zones.nEnr > n)
+    {
+        g_zones.built = zone_load(&g_zones, n);
+        if (g_zones.built)
+            return &g_zones;
+        zone_set_free(&g_zones);
+        g_zones.built = 1;
+    }
+    trace_begin("index", "zone_refresh", "%d..%ld", g_zones.nEnr, n);
+    OPEN_BIN_READ(FILE_ENR, fp);
+    int ok = fp && fseek(fp, (long)g_zones.nEnr * (long)sizeof(Enrollment), SEEK_SET) == 0;
+    Enrollment e;
+    long read = 0;
+    while (ok && g_zones.nEnr < n && fread(&e, sizeof(Enrollment), 1, fp) == 1)
+    {
+        ok = zone_push(&g_zones, &e);
+        read++;
+    }
+    if (fp)
+        fclose(fp);
+    trace_io(read, read * (long)sizeof(Enrollment));
+    trace_end();
+    if (!ok || g_zones.nEnr != n)
+    {
+        zone_set_free(&g_zones);
+        return NULL;
+    }
+    return &g_zones;
+}
+
+void zone_on_append(const Enrollment *e, long ref)
+{
+    if (g_zones.built && ref == g_zones.nEnr)
+        zone_push(&g_zones, e);
+    // otherwise zone_ensure() catches up on next use
+}
+
+/* Rows matching every non-NULL filter, reading only blocks that may hold
+ * them (malloc'd, may be NULL) */
+Enrollment *enr_scan(const char *term, const char *code, const char *sid, long *count)
+{
+    *count = 0;
+    int32_t nt;
+    const IdxEntry *byTerm = term ? index_range(IDX_ENROLLMENT_TERM, term, &nt) : NULL;
+    if (byTerm)
+    {
+        // the term index names the rows: read just those
+        Enrollment *out = nt ? (Enrollment *)malloc((size_t)nt * sizeof(Enrollment)) : NULL;
+        OPEN_BIN_READ(FILE_ENR, fp);
+        trace_begin("storage", "enr_scan", "term=%s via index, %d rows", term, nt);
+        for (int32_t i = 0; fp && out && i < nt; i++)
+        {
+            Enrollment *e = &out[*count];
+            if (fseek(fp, (long)byTerm[i].ref * (long)sizeof(Enrollment), SEEK_SET) == 0 &&
+                fread(e, sizeof(Enrollment), 1, fp) == 1 && strcmp(e->term, term) == 0 &&
+                (!code || strcmp(e->courseCode, code) == 0) && (!sid || strcmp(e->studentId, sid) == 0))
+                (*count)++;
+        }
+        if (fp)
+            fclose(fp);
+        trace_io(nt, nt * (long)sizeof(Enrollment));
+        trace_end();
+        return out;
+    }
+    ZoneSet *zs = g_cfg.zoneMaps ? zone_ensure() : NULL;
+    OPEN_BIN_READ(FILE_ENR, fp);
+    if (!fp)
+        return NULL;
+    trace_begin("storage", "enr_scan", "term=%s code=%s sid=%s", term ? term : "*", code ? code : "*",
+                sid ? redact_id(sid) : "*");
+    long nEnr = zs ? zs->nEnr : file_count_records(FILE_ENR, sizeof(Enrollment));
+    long nBlocks = (nEnr + ZONE_BLOCK - 1) / ZONE_BLOCK, skipped = 0, rows = 0, cap = 0;
+    Enrollment *buf = (Enrollment *)malloc(ZONE_BLOCK * sizeof(Enrollment)), *out = NULL;
+    for (long b = 0; buf && b < nBlocks; b++)
+    {
+        if (zs && !zone_may_match(&zs->z[b], term, code, sid))
+        {
+            skipped++;
+            continue;
+        }
+        if (fseek(fp, b * ZONE_BLOCK * (long)sizeof(Enrollment), SEEK_SET) != 0)
+            break;
+        size_t got = fread(buf, sizeof(Enrollment), ZONE_BLOCK, fp);
+        rows += (long)got;
+        for (size_t i = 0; i < got; i++)
+        {
+            const Enrollment *e = &buf[i];
+            if ((term && strcmp(e->term, term) != 0) || (code && strcmp(e->courseCode, code) != 0) ||
+                (sid && strcmp(e->studentId, sid) != 0))
+                continue;
+            if (*count == cap)
+            {
+                cap = cap ? cap * 2 : 16;
+                Enrollment *p = (Enrollment *)realloc(out, (size_t)cap * sizeof(Enrollment));
+                if (!p)
+                    break;
+                out = p;
+            }
+            out[(*count)++] = *e;
+        }
+    }
+    free(buf);
+    fclose(fp);
+    if (zs)
+    {
+        zs->scanned += nBlocks;
+        zs->skipped += skipped;
+    }
+    trace_args("skipped %ld of %ld blocks", skipped, nBlocks);
+    trace_io(rows, rows * (long)sizeof(Enrollment));
+    trace_end();
+    return out;
+}
+
+/* ======== ENROLLMENT ADJACENCY ========
+ * CSR-style lists: for each student (and each course) a contiguous run of
+ * enrollment record indices.  keys[] is sorted; the refs of key k are
+ * refs[off[k]] .. refs[off[k+1]-1], ascending so reads walk the file forward.
+ * Built in one pass over enrollments.dat, kept current by enroll_student and
+ * persisted to FILE_ADJ; a file whose record count does not match
+ * enrollments.dat is treated as stale and rebuilt.
+ */
+_Static_assert(MAX_CODE <= MAX_ID, "course codes share the adjacency key width");
+
+typedef struct
+{
+    int32_t nkeys, keyCap;
+    int32_t nrefs, refCap;
+    char (*keys)[MAX_ID];
+    int32_t *off; // nkeys + 1 entries
+    int32_t *refs;
+} AdjList;
+
+typedef struct
+{
+    int built, dirty;
+    int32_t nEnr; // enrollment records covered
+    AdjList byStudent, byCourse;
+} EnrAdj;
+
+static EnrAdj g_adj;
+
+#define ADJ_MAGIC 0x4A444155u /* "UADJ" */
+#define ADJ_VERSION 1u
+
+typedef struct
+{
+    char key[MAX_ID];
+    int32_t ref;
+} AdjPair;
+
+int cmp_adj_pair(const void *a, const void *b)
+{
+    const AdjPair *x = (const AdjPair *)a, *y = (const AdjPair *)b;
+    int c = strcmp(x->key, y->key);
+    return c ? c : (x->ref > y->ref) - (x->ref < y->ref);
+}
+
+void adj_list_free(AdjList *l)
+{
+    big_free(l->keys);
+    big_free(l->off);
+    big_free(l->refs);
+    memset(l, 0, sizeof(*l));
+}
+
+int adj_list_reserve(AdjList *l, int32_t keys, int32_t refs)
+{
+    if (keys > l->keyCap)
+    {
+        int32_t cap = l->keyCap ? l->keyCap : 64;
+        while (cap < keys)
+            cap *= 2;
+        char(*nk)[MAX_ID] = big_realloc(l->keys, (size_t)cap * MAX_ID);
+        int32_t *no = (int32_t *)big_realloc(l->off, ((size_t)cap + 1) * sizeof(int32_t));
+        if (nk)
+            l->keys = nk;
+        if (no)
+            l->off = no;
+        if (!nk || !no)
+            return 0;
+        l->keyCap = cap;
+    }
+    if (refs > l->refCap)
+    {
+        int32_t cap = l->refCap ? l->refCap : 256;
+        while (cap < refs)
+            cap *= 2;
+        int32_t *nr = (int32_t *)big_realloc(l->refs, (size_t)cap * sizeof(int32_t));
+        if (!nr)
+            return 0;
+        l->refs = nr;
+        l->refCap = cap;
+    }
+    return 1;
+}
+
+/* Group sorted (key, ref) pairs into a list */
+int adj_list_from_pairs(AdjList *l, const AdjPair *pairs, int32_t n)
+{
+    adj_list_free(l);
+    if (!adj_list_reserve(l, n ? n : 1, n ? n : 1))
+        return 0;
+    l->off[0] = 0;
+    for (int32_t i = 0; i < n; i++)
+    {
+        if (i == 0 || strcmp(pairs[i].key, pairs[i - 1].key) != 0)
+        {
+            memcpy(l->keys[l->nkeys], pairs[i].key, MAX_ID);
+            l->nkeys++;
+        }
+        l->refs[i] = pairs[i].ref;
+        l->off[l->nkeys] = i + 1;
+    }
+    l->nrefs = n;
+    return 1;
+}
+
+/* Index of key, or -(insertion point) - 1 when absent */
+int32_t adj_find(const AdjList *l, const char *key)
+{
+    int32_t lo = 0, hi = l->nkeys - 1;
+    while (lo <= hi)
+    {
+        int32_t mid = lo + (hi - lo) / 2;
+        int c = strcmp(l->keys[mid], key);
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -lo - 1;
+}
+
+/* Enrollment refs for key (NULL / 0 when none) */
+const int32_t *adj_refs(const AdjList *l, const char *key, int32_t *count)
+{
+    int32_t k = adj_find(l, key);
+    *count = (k < 0) ? 0 : l->off[k + 1] - l->off[k];
+    return (k < 0) ? NULL : l->refs + l->off[k];
+}
+
+/* Append ref to key's run; ref must be larger than any existing ref */
+int adj_list_add(AdjList *l, const char *key, int32_t ref)
+{
+    if (!adj_list_reserve(l, l->nkeys + 1, l->nrefs + 1))
+        return 0;
+    int32_t k = adj_find(l, key);
+    if (k < 0)
+    {
+        k = -k - 1;
+        memmove(l->keys[k + 1], l->keys[k], (size_t)(l->nkeys - k) * MAX_ID);
+        memmove(&l->off[k + 1], &l->off[k], (size_t)(l->nkeys - k + 1) * sizeof(int32_t));
+        memset(l->keys[k], 0, MAX_ID);
+        strncpy(l->keys[k], key, MAX_ID - 1);
+        l->nkeys++;
+    }
+    int32_t at = l->off[k + 1];
+    memmove(&l->refs[at + 1], &l->refs[at], (size_t)(l->nrefs - at) * sizeof(int32_t));
+    l->refs[at] = ref;
+    l->nrefs++;
+    for (int32_t i = k + 1; i <= l->nkeys; i++)
+        l->off[i]++;
+    return 1;
+}
+
+int adj_build(EnrAdj *a)
+{
+    long n;
+    Enrollment *enr = (Enrollment *)file_load_all(FILE_ENR, sizeof(Enrollment), &n);
+    AdjPair *pairs = (AdjPair *)malloc((n ? (size_t)n : 1) * sizeof(AdjPair));
+    int ok = pairs != NULL;
+    for (int side = 0; ok && side < 2; side++)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            memset(pairs[i].key, 0, MAX_ID);
+            strncpy(pairs[i].key, side == 0 ? enr[i].studentId : enr[i].courseCode, MAX_ID - 1);
+            pairs[i].ref = (int32_t)i;
+        }
+        qsort(pairs, (size_t)n, sizeof(AdjPair), cmp_adj_pair);
+        ok = adj_list_from_pairs(side == 0 ? &a->byStudent : &a->byCourse, pairs, (int32_t)n);
+    }
+    free(pairs);
+    free(enr);
+    a->nEnr = (int32_t)n;
+    a->built = ok;
+    a->dirty = ok;
+    return ok;
+}
+
+int adj_list_write(FILE *fp, const AdjList *l)
+{
+    return fwrite(&l->nkeys, sizeof(int32_t), 1, fp) == 1 &&
+           fwrite(&l->nrefs, sizeof(int32_t), 1, fp) == 1 &&
+           fwrite(l->keys, MAX_ID, (size_t)l->nkeys, fp) == (size_t)l->nkeys &&
+           fwrite(l->off, sizeof(int32_t), (size_t)l->nkeys + 1, fp) == (size_t)l->nkeys + 1 &&
+           fwrite(l->refs, sizeof(int32_t), (size_t)l->nrefs, fp) == (size_t)l->nrefs;
+}
+
+/* Structural checks so a damaged file is rebuilt instead of trusted:
+ * offsets rise from 0 to nrefs, keys are terminated and strictly sorted,
+ * refs are in range and ascending within each key. */
+int adj_list_valid(const AdjList *l, int32_t nEnr)
+{
+    if (l->off[0] != 0 || l->off[l->nkeys] != l->nrefs)
+        return 0;
+    for (int32_t k = 0; k < l->nkeys; k++)
+    {
+        if (memchr(l->keys[k], 0, MAX_ID) == NULL || l->off[k + 1] <= l->off[k])
+            return 0;
+        if (k > 0 && strcmp(l->keys[k - 1], l->keys[k]) >= 0)
+            return 0;
+        for (int32_t r = l->off[k]; r < l->off[k + 1]; r++)
+            if (l->refs[r] < 0 || l->refs[r] >= nEnr || (r > l->off[k] && l->refs[r] <= l->refs[r - 1]))
+                return 0;
+    }
+    return 1;
+}
+
+int adj_list_read(FILE *fp, AdjList *l, int32_t nEnr)
+{
+    int32_t nk, nr;
+    adj_list_free(l);
+    // every enrollment appears exactly once per side, which bounds both counts
+    if (fread(&nk, sizeof(int32_t), 1, fp) != 1 || fread(&nr, sizeof(int32_t), 1, fp) != 1 ||
+        nr != nEnr || nk < 0 || nk > nr || !adj_list_reserve(l, nk ? nk : 1, nr ? nr : 1))
+        return 0;
+    l->nkeys = nk;
+    l->nrefs = nr;
+    return fread(l->keys, MAX_ID, (size_t)nk, fp) == (size_t)nk &&
+           fread(l->off, sizeof(int32_t), (size_t)nk + 1, fp) == (size_t)nk + 1 &&
+           fread(l->refs, sizeof(int32_t), (size_t)nr, fp) == (size_t)nr && adj_list_valid(l, nEnr);
+}
+
+int adj_save_as(EnrAdj *a, const char *path)
+{
+    OPEN_BIN_WRITE(path, fp);
+    if (!fp)
+        return 0;
+    uint32_t hdr[2] = {ADJ_MAGIC, ADJ_VERSION};
+    int ok = fwrite(hdr, sizeof(hdr), 1, fp) == 1 && fwrite(&a->nEnr, sizeof(int32_t), 1, fp) == 1 &&
+             adj_list_write(fp, &a->byStudent) && adj_list_write(fp, &a->byCourse);
+    fclose(fp);
+    if (ok)
+        a->dirty = 0;
+    return ok;
+}
+
+int adj_save(EnrAdj *a)
+{
+    return adj_save_as(a, FILE_ADJ);
+}
+
+/* Load FILE_ADJ if it covers exactly nEnr records */
+int adj_load(EnrAdj *a, long nEnr)
+{
+    OPEN_BIN_READ(FILE_ADJ, fp);
+    if (!fp)
+        return 0;
+    uint32_t hdr[2];
+    int32_t n = 0;
+    int ok = fread(hdr, sizeof(hdr), 1, fp) == 1 && hdr[0] == ADJ_MAGIC && hdr[1] == ADJ_VERSION &&
+             fread(&n, sizeof(int32_t), 1, fp) == 1 && n == nEnr &&
+             adj_list_read(fp, &a->byStudent, n) && adj_list_read(fp, &a->byCourse, n);
+    fclose(fp);
+    a->nEnr = n;
+    a->built = ok;
+    a->dirty = 0;
+    return ok;
+}
+
+/* Make g_adj match enrollments.dat, loading or rebuilding as needed */
+EnrAdj *adj_ensure()
+{
+    long n = file_count_records(FILE_ENR, sizeof(Enrollment));
+    if (g_adj.built && g_adj.nEnr == n)
+        return &g_adj;
+    trace_begin("index", "adj_refresh", "%ld records", n);
+    if (!adj_load(&g_adj, n))
+    {
+        adj_build(&g_adj);
+        adj_save(&g_adj);
+    }
+    trace_end();
+    return g_adj.built ? &g_adj : NULL;
+}
+
+/* Record an enrollment just appended at index ref */
+void adj_on_append(const Enrollment *e, long ref)
+{
+    if (!g_adj.built || g_adj.nEnr != ref)
+        return; // out of sync; adj_ensure() rebuilds on next use
+    if (adj_list_add(&g_adj.byStudent, e->studentId, (int32_t)ref) &&
+        adj_list_add(&g_adj.byCourse, e->courseCode, (int32_t)ref))
+    {
+        g_adj.nEnr++;
+        g_adj.dirty = 1;
+    }
+    else
+        g_adj.built = 0;
+}
+
+/* Read the enrollment records named by refs (ascending) with one open file */
+long enr_read_refs(const int32_t *refs, int32_t n, Enrollment *out)
+{
+    OPEN_BIN_READ(FILE_ENR, fp);
+    if (!fp)
+        return 0;
+    trace_begin("storage", "enr_read_refs", "%d refs", n);
+    long got = 0;
+    for (int32_t i = 0; i < n; i++)
+    {
+        if (fseek(fp, (long)refs[i] * (long)sizeof(Enrollment), SEEK_SET) != 0 ||
+            fread(&out[got], sizeof(Enrollment), 1, fp) != 1)
+            continue;
+        got++;
+    }
+    fclose(fp);
+    trace_io(got, got * (long)sizeof(Enrollment));
+    trace_end();
+    return got;
+}
+
+/* All enrollments of one student, or of one course (malloc'd, may be NULL) */
+Enrollment *enr_for_key(int byCourse, const char *key, long *count)
+{
+    *count = 0;
+    if (g_cfg.enrIndex == ENR_INDEX_SCAN)
+        return enr_scan(NULL, byCourse ? key : NULL, byCourse ? NULL : key, count);
+    EnrAdj *a = adj_ensure();
+    if (!a)
+        return NULL;
+    int32_t n;
+    const int32_t *refs = adj_refs(byCourse ? &a->byCourse : &a->byStudent, key, &n);
+    if (!n)
+        return NULL;
+    Enrollment *out = (Enrollment *)malloc((size_t)n * sizeof(Enrollment));
+    if (out)
+        *count = enr_read_refs(refs, n, out);
+    return out;
+}
+
+/* ======== CO-ENROLLMENT ========
+ * Per-term course x course matrix: counts[i*n+j] = students taking both
+ * course i and course j that term (diagonal = class size).  Built from the
+ * per-course adjacency runs by intersecting sorted student-number lists,
+ * cached for a few terms (LRU) and patched in place on each new enrollment.
+ */
+typedef struct
+{
+    char term[MAX_TERM];
+    int32_t n;               // courses with enrollments in this term
+    char (*codes)[MAX_CODE]; // sorted
+    int32_t *counts;         // n * n, symmetric
+    int32_t nEnr;            // enrollment records covered
+    unsigned long lastUse;
+} CoTerm;
+
+static CoTerm g_coterm[COENR_MAX_TERMS];
+static unsigned long g_coterm_clock;
+
+void coterm_free(CoTerm *ct)
+{
+    big_free(ct->codes);
+    big_free(ct->counts);
+    memset(ct, 0, sizeof(*ct));
+}
+
+int cmp_int32(const void *a, const void *b)
+{
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Size of the intersection of two ascending lists */
+int32_t sorted_intersect_count(const int32_t *a, int32_t na, const int32_t *b, int32_t nb)
+{
+    int32_t i = 0, j = 0, c = 0;
+    while (i < na && j < nb)
+    {
+        if (a[i] < b[j])
+            i++;
+        else if (a[i] > b[j])
+            j++;
+        else
+        {
+            c++;
+            i++;
+            j++;
+        }
+    }
+    return c;
+}
+
+int coterm_build(CoTerm *ct, const char *term)
+{
+    EnrAdj *a = adj_ensure();
+    if (!a)
+        return 0;
+    trace_begin("index", "coterm_build", "term=%s", term);
+    long ne;
+    Enrollment *enr = (Enrollment *)file_load_all(FILE_ENR, sizeof(Enrollment), &ne);
+    const AdjList *bc = &a->byCourse;
+    // student numbers (index into byStudent keys) per course, CSR again
+    int32_t *off = (int32_t *)calloc((size_t)bc->nkeys + 1, sizeof(int32_t));
+    int32_t *stu = (int32_t *)malloc((bc->nrefs ? (size_t)bc->nrefs : 1) * sizeof(int32_t));
+    int32_t *courseOf = (int32_t *)malloc((bc->nkeys ? (size_t)bc->nkeys : 1) * sizeof(int32_t));
+    coterm_free(ct);
+    int ok = off && stu && courseOf;
+    int32_t n = 0, m = 0;
+    for (int32_t k = 0; ok && k < bc->nkeys; k++)
+    {
+        int32_t start = m;
+        for (int32_t r = bc->off[k]; r < bc->off[k + 1]; r++)
+        {
+            int32_t ref = bc->refs[r];
+            if (ref < ne && strcmp(enr[ref].term, term) == 0)
+                stu[m++] = adj_find(&a->byStudent, enr[ref].studentId);
+        }
+        if (m == start)
+            continue;
+        qsort(stu + start, (size_t)(m - start), sizeof(int32_t), cmp_int32);
+        courseOf[n] = k;
+        off[n++] = start;
+    }
+    off[n] = m;
+    if (ok)
+    {
+        ct->codes = big_alloc((n ? (size_t)n : 1) * MAX_CODE);
+        ct->counts = (int32_t *)big_calloc((n ? (size_t)n * (size_t)n : 1) * sizeof(int32_t));
+        ok = ct->codes && ct->counts;
+    }
+    for (int32_t i = 0; ok && i < n; i++)
+    {
+        memcpy(ct->codes[i], bc->keys[courseOf[i]], MAX_CODE);
+        ct->counts[(size_t)i * n + i] = off[i + 1] - off[i];
+        for (int32_t j = i + 1; j < n; j++)
+        {
+            int32_t c = sorted_intersect_count(stu + off[i], off[i + 1] - off[i], stu + off[j], off[j + 1] - off[j]);
+            ct->counts[(size_t)i * n + j] = ct->counts[(size_t)j * n + i] = c;
+        }
+    }
+    free(off);
+    free(stu);
+    free(courseOf);
+    free(enr);
+    trace_end();
+    if (!ok)
+    {
+        coterm_free(ct);
+        return 0;
+    }
+    strncpy(ct->term, term, MAX_TERM - 1);
+    ct->n = n;
+    ct->nEnr = a->nEnr;
+    return 1;
+}
+
+int32_t coterm_course_index(const CoTerm *ct, const char *code)
+{
+    int32_t lo = 0, hi = ct->n - 1;
+    while (lo <= hi)
+    {
+        int32_t mid = lo + (hi - lo) / 2;
+        int c = strcmp(ct->codes[mid], code);
+        if (c == 0)
+            return mid;
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -1;
+}
+
+/* Cached matrix for term, (re)built when missing or out of date */
+CoTerm *coterm_get(const char *term)
+{
+    EnrAdj *a = adj_ensure();
+    if (!a)
+        return NULL;
+    for (int i = (int)g_cfg.coenrollTerms; i < COENR_MAX_TERMS; i++)
+        coterm_free(&g_coterm[i]); // slots beyond a lowered coenroll_terms
+    CoTerm *slot = &g_coterm[0];
+    for (int i = 0; i < g_cfg.coenrollTerms; i++)
+    {
+        CoTerm *ct = &g_coterm[i];
+        if (ct->codes && strcmp(ct->term, term) == 0)
+        {
+            if (ct->nEnr != a->nEnr && !coterm_build(ct, term))
+                return NULL;
+            ct->lastUse = ++g_coterm_clock;
+            return ct;
+        }
+        if (ct->lastUse < slot->lastUse)
+            slot = ct; // least recently used (empty slots have lastUse 0)
+    }
+    if (!coterm_build(slot, term))
+        return NULL;
+    slot->lastUse = ++g_coterm_clock;
+    return slot;
+}
+
+/* Patch cached matrices for an enrollment appended at index ref */
+void coenroll_on_append(const Enrollment *e, long ref)
+{
+    for (int i = 0; i < COENR_MAX_TERMS; i++)
+    {
+        CoTerm *ct = &g_coterm[i];
+        if (!ct->codes || ct->nEnr != ref)
+            continue; // stale entries rebuild on next query
+        if (strcmp(ct->term, e->term) != 0)
+        {
+            ct->nEnr++;
+            continue;
+        }
+        int32_t ci = coterm_course_index(ct, e->courseCode);
+        if (ci < 0)
+        {
+            coterm_free(ct); // new course this term: matrix shape changes
+            continue;
+        }
+        long n;
+        Enrollment *mine = enr_for_key(0, e->studentId, &n);
+        for (long k = 0; k < n; k++)
+        {
+            if (strcmp(mine[k].term, e->term) != 0)
+                continue;
+            int32_t cj = coterm_course_index(ct, mine[k].courseCode);
+            if (cj < 0 || cj == ci)
+                continue;
+            ct->counts[(size_t)ci * ct->n + cj]++;
+            ct->counts[(size_t)cj * ct->n + ci]++;
+        }
+        free(mine);
+        ct->counts[(size_t)ci * ct->n + ci]++;
+        ct->nEnr++;
+    }
+}
+
+void related_courses(const char *code, const char *term, int topN)
+{
+    trace_args("code=%s term=%s n=%d", code, term, topN);
+    CoTerm *ct = coterm_get(term);
+    int32_t ci = ct ? coterm_course_index(ct, code) : -1;
+    if (ci < 0)
+    {
+        printf("No enrollments for %s in %s.\n", code, term);
+        return;
+    }
+    const int32_t *row = ct->counts + (size_t)ci * ct->n;
+    int32_t size = row[ci];
+    printf("\n-- Courses taken with %s (%s, %d students) --\n", code, term, size);
+    // repeated max selection; N is small compared to the course count
+    unsigned char *used = (unsigned char *)calloc((size_t)ct->n, 1);
+    int shown = 0;
+    for (; used && shown < topN; shown++)
+    {
+        int32_t best = -1;
+        for (int32_t j = 0; j < ct->n; j++)
+            if (j != ci && !used[j] && row[j] > 0 && (best < 0 || row[j] > row[best]))
+                best = j;
+        if (best < 0)
+            break;
+        used[best] = 1;
+        Course c;
+        int have = file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, ct->codes[best], &c) >= 0;
+        printf("%2d) %-10s %-28s %4d shared (%.0f%%)\n", shown + 1, ct->codes[best], have ? c.title : "",
+               row[best], 100.0 * row[best] / size);
+    }
+    free(used);
+    if (!shown)
+        printf("No other courses share students with %s.\n", code);
+}
+
+/* ======== RESULT CACHE ========
+ * Rendered transcripts and leaderboards are kept keyed by (report, param).
+ * While a report is built it records what it read as dependencies: a
+ * student's enrollments/profile, a course, or a whole term.  The change
+ * hooks below (called by every write path) drop exactly the entries that
+ * depend on what changed.  As a guard against writers that bypass the
+ * hooks (other processes, --serve on the same folder), an entry is also
+ * discarded if the enrollment or course file has changed since it was
+ * built: its size, its in-place rewrite epoch, or its modification time.
+ * A file modified within the last second is not trusted to show the next
+ * change in its time stamp, so reports read from it are not kept.  The
+ * settings generation is checked the same way.  One cache per campus,
+ * parked with the other caches (see TENANTS).
+ */
+enum
+{
+    REPORT_TRANSCRIPT,
+    REPORT_LEADERBOARD
+};
+enum
+{
+    DEP_STUDENT, // enrollments and profile of one student
+    DEP_COURSE,  // one course record
+    DEP_TERM     // every enrollment in one term
+};
+
+typedef struct
+{
+    int kind;
+    char key[MAX_ID]; // MAX_ID == MAX_CODE == MAX_TERM
+} ReportDep;
+
+typedef struct
+{
+    long recs;     // size in records
+    long epoch;    // in-place rewrites by this process (g_fileEpoch)
+    int64_t mtime; // ns; also moves on rewrites by other processes
+} FileStamp;
+
+typedef struct
+{
+    int used, report;
+    char param[MAX_ID];
+    StrBuf out;
+    ReportDep *deps;
+    int ndeps, depCap;
+    FileStamp enr, course; // the files as they were when built
+    unsigned long cfgGen;  // settings in force when built (leaderboard_max)
+    unsigned long lastUse;
+} ReportEntry;
+
+typedef struct
+{
+    ReportEntry e[REPORT_CACHE_SLOTS];
+    unsigned long clock;
+    long hits, misses, invalidated;
+} ReportCache;
+
+static ReportCache g_reports;
+
+void report_entry_free(ReportEntry *r)
+{
+    sb_free(&r->out);
+    free(r->deps);
+    memset(r, 0, sizeof(*r));
+}
+
+void report_cache_clear(ReportCache *c)
+{
+    for (int i = 0; i < REPORT_CACHE_SLOTS; i++)
+        report_entry_free(&c->e[i]);
+}
+
+long report_cache_mem_usage(const ReportCache *c)
+{
+    long bytes = 0;
+    for (int i = 0; i < REPORT_CACHE_SLOTS; i++)
+        bytes += (long)c->e[i].out.cap + (long)c->e[i].depCap * (long)sizeof(ReportDep);
+    return bytes;
+}
+
+void report_dep(ReportEntry *r, int kind, const char *key)
+{
+    if (!r)
+        return;
+    for (int i = 0; i < r->ndeps; i++)
+        if (r->deps[i].kind == kind && strcmp(r->deps[i].key, key) == 0)
+            return;
+    if (r->ndeps == r->depCap)
+    {
+        int cap = r->depCap ? r->depCap * 2 : 8;
+        ReportDep *nd = (ReportDep *)realloc(r->deps, (size_t)cap * sizeof(ReportDep));
+        if (!nd)
+        {
+            r->used = 0; // cannot track it, so do not keep it
+            return;
+        }
+        r->deps = nd;
+        r->depCap = cap;
+    }
+    ReportDep *d = &r->deps[r->ndeps++];
+    d->kind = kind;
+    snprintf(d->key, sizeof(d->key), "%s", key);
+}
+
+/* Drop every cached report that read (kind, key) */
+void report_invalidate(int kind, const char *key)
+{
+    for (int i = 0; i < REPORT_CACHE_SLOTS; i++)
+    {
+        ReportEntry *r = &g_reports.e[i];
+        for (int k = 0; r->used && k < r->ndeps; k++)
+            if (r->deps[k].kind == kind && strcmp(r->deps[k].key, key) == 0)
+            {
+                report_entry_free(r);
+                g_reports.invalidated++;
+            }
+    }
+}
+
+FileStamp file_stamp(int f, size_t recSize)
+{
+    FileStamp st = {file_count_records(g_dataFiles[f], recSize), g_fileEpoch[f], file_mtime(g_dataFiles[f])};
+    return st;
+}
+
+int file_stamp_same(const FileStamp *a, const FileStamp *b)
+{
+    return a->recs == b->recs && a->epoch == b->epoch && a->mtime == b->mtime;
+}
+
+/* Modified so recently that a further write may not move the time stamp */
+int file_stamp_racy(const FileStamp *st)
+{
+    return st->mtime / 1000000000 >= (int64_t)time(NULL) - 1;
+}
+
+/* Print a report, from the cache when possible.  build() renders into out
+ * and declares its dependencies on r (r may be NULL when caching is off). */
+void report_show(int report, const char *param, void (*build)(const char *, StrBuf *, ReportEntry *))
+{
+    FileStamp enr = file_stamp(TF_ENR, sizeof(Enrollment));
+    FileStamp course = file_stamp(TF_COURSE, sizeof(Course));
+    ReportEntry *r = NULL, *victim = NULL;
+    for (int i = 0; i < g_cfg.reportCacheEntries && !r; i++)
+    {
+        ReportEntry *x = &g_reports.e[i];
+        if (x->used && x->report == report && strcmp(x->param, param) == 0)
+            r = x;
+        else if (!victim || (victim->used && (!x->used || x->lastUse < victim->lastUse)))
+            victim = x;
+    }
+    for (int i = (int)g_cfg.reportCacheEntries; i < REPORT_CACHE_SLOTS; i++)
+        report_entry_free(&g_reports.e[i]); // slots beyond a lowered report_cache_entries
+    if (r && (!file_stamp_same(&r->enr, &enr) || !file_stamp_same(&r->course, &course) || r->cfgGen != g_cfgGen))
+    {
+        report_entry_free(r); // files changed behind our back
+        victim = r;
+        r = NULL;
+    }
+    if (r)
+    {
+        g_reports.hits++;
+        r->lastUse = ++g_reports.clock;
+        trace_args("cache=hit");
+        fputs(r->out.p, stdout);
+        return;
+    }
+    g_reports.misses++;
+    StrBuf out = {0};
+    if (victim)
+    {
+        report_entry_free(victim);
+        victim->used = 1;
+    }
+    build(param, &out, victim);
+    if (out.p)
+        fputs(out.p, stdout);
+    if (victim && victim->used && out.p && !file_stamp_racy(&enr) && !file_stamp_racy(&course))
+    {
+        victim->report = report;
+        snprintf(victim->param, sizeof(victim->param), "%s", param);
+        victim->out = out;
+        victim->enr = enr;
+        victim->course = course;
+        victim->cfgGen = g_cfgGen;
+        victim->lastUse = ++g_reports.clock;
+        return;
+    }
+    if (victim)
+        report_entry_free(victim);
+    sb_free(&out);
+}
+
+/* ---- change hooks: every write path reports what it touched ---- */
+void snapshot_mark(const char *sid);
+void snapshot_mark_course(const char *code);
+void roster_patch(const char *term, const char *code, const char *sid, const char *name, const char *grade);
+
+/* Everything derived from enrollments.dat that follows appends */
+void on_enrollment_appended(const Enrollment *e, long ref)
+{
+    adj_on_append(e, ref); // first: the co-enrollment patch reads the student's list
+    coenroll_on_append(e, ref);
+    zone_on_append(e, ref);
+    report_invalidate(DEP_STUDENT, e->studentId);
+    report_invalidate(DEP_TERM, e->term);
+    snapshot_mark(e->studentId);
+    roster_patch(e->term, e->courseCode, e->studentId, "", e->grade);
+}
+
+void on_grade_changed(const Enrollment *e)
+{
+    report_invalidate(DEP_STUDENT, e->studentId);
+    report_invalidate(DEP_TERM, e->term);
+    snapshot_mark(e->studentId);
+    roster_patch(e->term, e->courseCode, e->studentId, "", e->grade);
+}
+
+void on_student_changed(const Student *s)
+{
+    report_invalidate(DEP_STUDENT, s->id);
+    snapshot_mark(s->id);
+    roster_patch(NULL, "", s->id, s->name, ""); // the name is on every roster the student is in
+}
+
+void on_course_changed(const char *code)
+{
+    report_invalidate(DEP_COURSE, code);
+    snapshot_mark_course(code);
+}
+
+/* ======== TENANTS ========
+ * One process can serve several campuses, each with its own data root
+ * (given on the command line as NAME=DIR or just DIR).  The g_adj, g_coterm
+ * and g_reports caches always belong to the active tenant; switching tenants
+ * parks them in the outgoing Tenant and restores the incoming one's.
+ * Parked caches are trimmed to a per-tenant memory quota and dropped
+ * entirely once a tenant has been idle (tenant_mem_quota_mb and
+ * tenant_idle_secs in the settings file).
+ */
+#define MAX_TENANTS 16
+
+typedef struct
+{
+    char name[MAX_NAME];
+    char root[MAX_PATH_LEN - 32]; // leaves room for "/<file name>"
+    time_t lastUse;
+    EnrAdj adj; // parked caches (while another tenant is active)
+    CoTerm coterm[COENR_MAX_TERMS];
+    unsigned long cotermClock;
+    ReportCache reports;
+    ZoneSet zones;
+    SecIndex idx[IDX_COUNT];
+    long fileEpoch[TF_COUNT]; // the tenant's g_fileEpoch, so its index builds survive a switch
+} Tenant;
+
+static Tenant g_tenants[MAX_TENANTS];
+static int g_nTenants;
+static Tenant *g_tenant;
+
+long adj_mem_usage(const EnrAdj *a)
+{
+    const AdjList *l[2] = {&a->byStudent, &a->byCourse};
+    long bytes = 0;
+    for (int i = 0; i < 2; i++)
+        bytes += (long)l[i]->keyCap * (MAX_ID + (long)sizeof(int32_t)) + (long)l[i]->refCap * (long)sizeof(int32_t);
+    return bytes;
+}
+
+long coterm_mem_usage(const CoTerm *ct)
+{
+    return ct->codes ? (long)ct->n * MAX_CODE + (long)ct->n * ct->n * (long)sizeof(int32_t) : 0;
+}
+
+long tenant_mem_usage(const Tenant *t)
+{
+    int active = (t == g_tenant);
+    long bytes = adj_mem_usage(active ? &g_adj : &t->adj);
+    for (int i = 0; i < COENR_MAX_TERMS; i++)
+        bytes += coterm_mem_usage(active ? &g_coterm[i] : &t->coterm[i]);
+    bytes += zone_mem_usage(active ? &g_zones : &t->zones);
+    for (int i = 0; i < IDX_COUNT; i++)
+        bytes += sec_index_mem_usage(active ? &g_idx[i] : &t->idx[i]);
+    return bytes + report_cache_mem_usage(active ? &g_reports : &t->reports);
+}
+
+void snapshot_flush(int budget);
+
+/* Path of one of t's data files, whether or not t is active */
+void tenant_file(const Tenant *t, int f, char out[MAX_PATH_LEN])
+{
+    if (strcmp(t->root, ".") == 0)
+        snprintf(out, MAX_PATH_LEN, "%s", TENANT_FILE_NAMES[f]);
+    else
+        snprintf(out, MAX_PATH_LEN, "%s/%s", t->root, TENANT_FILE_NAMES[f]);
+}
+
+void tenant_activate(Tenant *t)
+{
+    if (t == g_tenant)
+        return;
+    snapshot_flush(-1); // the snapshot queue is not parked
+    if (g_tenant)
+    {
+        g_tenant->adj = g_adj;
+        memcpy(g_tenant->coterm, g_coterm, sizeof(g_coterm));
+        g_tenant->cotermClock = g_coterm_clock;
+        g_tenant->reports = g_reports;
+        g_tenant->zones = g_zones;
+        memcpy(g_tenant->idx, g_idx, sizeof(g_idx));
+        memcpy(g_tenant->fileEpoch, g_fileEpoch, sizeof(g_fileEpoch));
+    }
+    g_adj = t->adj;
+    memcpy(g_coterm, t->coterm, sizeof(g_coterm));
+    g_coterm_clock = t->cotermClock;
+    g_reports = t->reports;
+    g_zones = t->zones;
+    memcpy(g_idx, t->idx, sizeof(g_idx));
+    memcpy(g_fileEpoch, t->fileEpoch, sizeof(g_fileEpoch));
+    memset(&t->adj, 0, sizeof(t->adj));
+    memset(t->coterm, 0, sizeof(t->coterm));
+    memset(&t->reports, 0, sizeof(t->reports));
+    memset(&t->zones, 0, sizeof(t->zones));
+    memset(t->idx, 0, sizeof(t->idx));
+    for (int f = 0; f < TF_COUNT; f++)
+        tenant_file(t, f, g_dataFiles[f]);
+    g_tenant = t;
+    t->lastUse = time(NULL);
+    g_traceCampus = (int)(t - g_tenants) + 1;
+    g_traceCampusName = t->name;
+}
+
+/* Drop one tenant's caches, active or parked (saving the adjacency and
+ * zone maps to t's files first) */
+void caches_drop(const Tenant *t, EnrAdj *adj, CoTerm *coterm, ReportCache *reports, ZoneSet *zones,
+                 SecIndex *idx, int keepAdj)
+{
+    report_cache_clear(reports);
+    for (int i = 0; i < COENR_MAX_TERMS; i++)
+        coterm_free(&coterm[i]);
+    if (keepAdj)
+        return;
+    char path[MAX_PATH_LEN];
+    if (adj->dirty)
+    {
+        tenant_file(t, TF_ADJ, path);
+        adj_save_as(adj, path);
+    }
+    if (zones->dirty)
+    {
+        tenant_file(t, TF_ZONES, path);
+        zone_save_as(zones, path);
+    }
+    zone_set_free(zones);
+    for (int i = 0; i < IDX_COUNT; i++)
+        sec_index_free(&idx[i]);
+    adj_list_free(&adj->byStudent);
+    adj_list_free(&adj->byCourse);
+    memset(adj, 0, sizeof(*adj));
+}
+
+/* Drop caches of the active tenant */
+void tenant_drop_caches(int keepAdj)
+{
+    caches_drop(g_tenant, &g_adj, g_coterm, &g_reports, &g_zones, g_idx, keepAdj);
+}
+
+/* Drop a parked tenant's caches in place: no switch, and not a use */
+void tenant_drop_parked(Tenant *t, int keepAdj)
+{
+    caches_drop(t, &t->adj, t->coterm, &t->reports, &t->zones, t->idx, keepAdj);
+}
+
+/* Evict idle tenants and enforce the per-tenant quota on parked caches */
+void tenant_housekeeping()
+{
+    Tenant *cur = g_tenant;
+    time_t now = time(NULL);
+    for (int i = 0; i < g_nTenants; i++)
+    {
+        Tenant *t = &g_tenants[i];
+        if (t == cur || !tenant_mem_usage(t))
+            continue;
+        long quota = g_cfg.tenantMemQuotaMb << 20;
+        int idle = now - t->lastUse >= g_cfg.tenantIdleSecs;
+        if (!idle && tenant_mem_usage(t) <= quota)
+            continue;
+        tenant_drop_parked(t, 1); // reports and co-enrollment matrices go first
+        if (idle || tenant_mem_usage(t) > quota)
+            tenant_drop_parked(t, 0);
+    }
+}
+
+int tenant_add(const char *spec)
+{
+    if (g_nTenants >= MAX_TENANTS)
+        return 0;
+    Tenant *t = &g_tenants[g_nTenants];
+    memset(t, 0, sizeof(*t));
+    const char *eq = strchr(spec, '=');
+    const char *root = eq ? eq + 1 : spec;
+    const char *base = strrchr(root, '/');
+    snprintf(t->root, sizeof(t->root), "%s", root[0] ? root : ".");
+    if (eq)
+        snprintf(t->name, sizeof(t->name), "%.*s", (int)(eq - spec), spec);
+    else
+        snprintf(t->name, sizeof(t->name), "%s", base && base[1] ? base + 1 : root);
+    if (strcmp(t->root, ".") != 0)
+        MKDIR(t->root);
+    g_nTenants++;
+    return 1;
+}
+
+/* Pick the tenant for the next login; returns 0 on an unknown campus */
+int tenant_select()
+{
+    if (g_nTenants == 1)
+    {
+        tenant_activate(&g_tenants[0]);
+        return 1;
+    }
+    char name[MAX_NAME];
+    printf("Campuses:");
+    for (int i = 0; i < g_nTenants; i++)
+        printf(" %s", g_tenants[i].name);
+    read_line("\nCampus: ", name, sizeof(name));
+    for (int i = 0; i < g_nTenants; i++)
+        if (strcmp(g_tenants[i].name, name) == 0)
+        {
+            tenant_activate(&g_tenants[i]);
+            return 1;
+        }
+    printf("Unknown campus.\n");
+    return 0;
+}
+
+/* ======== FIXED-POINT GRADES ========
+ * Credits and grade points are hundredths (3.0 cr = 300, B+ = 330) and
+ * quality points their product, so every sum is exact int64 arithmetic:
+ * the same CGPA comes out whatever order rows are added in.  Course.credit
+ * stays a float on disk and is converted once, when rows are joined.
+ */
+typedef struct
+{
+    const char *grade;
+    int pointsX100;
+} GradePoints;
+
+// UIU-like 4.0 scale (adjust if your dept uses different)
+static const GradePoints GRADE_SCALE[] = {
+    {"A", 400}, {"A-", 370}, {"B+", 330}, {"B", 300}, {"B-", 270},
+    {"C+", 230}, {"C", 200}, {"C-", 170}, {"D", 100}, {"F", 0}};
+
+/* Grade points x100, or -1 for ungraded/invalid */
+int grade_to_points_x100(const char *g)
+{
+    for (size_t i = 0; i < sizeof(GRADE_SCALE) / sizeof(GRADE_SCALE[0]); i++)
+        if (strcmp(g, GRADE_SCALE[i].grade) == 0)
+            return GRADE_SCALE[i].pointsX100;
+    return -1;
+}
+
+float grade_to_points(const char *g)
+{
+    int p = grade_to_points_x100(g);
+    return p < 0 ? -1.0f : p / 100.0f;
+}
+
+/* Stored float credit -> hundredths, rounded to nearest */
+int32_t credit_x100(float credit)
+{
+    return (int32_t)(credit * 100.0f + (credit >= 0 ? 0.5f : -0.5f));
+}
+
+/* Quality points (x10^4) over credits (x100) -> GPA x100, rounded half up */
+int64_t gpa_x100(int64_t qp, int64_t credX100)
+{
+    return credX100 > 0 ? (qp + credX100 / 2) / credX100 : 0;
+}
+
+/* Exact GPA comparison by cross-multiplication (-1, 0, 1) */
+int gpa_cmp(int64_t qp1, int64_t cred1, int64_t qp2, int64_t cred2)
+{
+    int64_t a = cred1 > 0 ? qp1 * (cred2 > 0 ? cred2 : 1) : 0;
+    int64_t b = cred2 > 0 ? qp2 * (cred1 > 0 ? cred1 : 1) : 0;
+    return (a > b) - (a < b);
+}
+
+/* ======== GPA KERNEL ========
+ * Term and cumulative GPA are one aggregation: for every row add
+ * points*credits and credits into its group (student).  Rows are laid out
+ * as columns and the loop has no data-dependent branches: ungraded rows,
+ * rows whose course was not found and rows of other students are masked
+ * to zero instead of skipped, then scatter-added.  On x86 with AVX2 the
+ * mask/multiply runs 8 rows at a time (chosen at run time); the scalar
+ * loop is the same computation and the fallback everywhere else.
+ */
+typedef struct
+{
+    int32_t *group;    // dense group number (student)
+    int32_t *credX100; // credits x100
+    int32_t *ptsX100;  // grade points x100, -1 ungraded
+    int32_t *valid;    // -1 = row counts, 0 = masked out
+    int32_t n, cap;
+} GpaColumns;
+
+void gpa_cols_free(GpaColumns *c)
+{
+    free(c->group);
+    free(c->credX100);
+    free(c->ptsX100);
+    free(c->valid);
+    memset(c, 0, sizeof(*c));
+}
+
+int gpa_cols_push(GpaColumns *c, int32_t group, int32_t credX100, int32_t ptsX100, int valid)
+{
+    if (c->n == c->cap)
+    {
+        int32_t cap = c->cap ? c->cap * 2 : 256;
+        int32_t **cols[4] = {&c->group, &c->credX100, &c->ptsX100, &c->valid};
+        for (int i = 0; i < 4; i++)
+        {
+            int32_t *p = (int32_t *)realloc(*cols[i], (size_t)cap * sizeof(int32_t));
+            if (!p)
+                return 0;
+            *cols[i] = p;
+        }
+        c->cap = cap;
+    }
+    c->group[c->n] = group;
+    c->credX100[c->n] = credX100;
+    c->ptsX100[c->n] = ptsX100;
+    c->valid[c->n] = valid ? -1 : 0;
+    c->n++;
+    return 1;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GPA_KERNEL_AVX2 1
+
+/* 8 rows per step; returns the number of rows handled */
+__attribute__((target("avx2"))) int32_t gpa_kernel_avx2(const GpaColumns *c, int64_t *qp, int64_t *cred, int32_t *graded)
+{
+    int32_t i = 0;
+    int32_t q[8], cr[8], gr[8];
+    const __m256i ungraded = _mm256_set1_epi32(-1), one = _mm256_set1_epi32(1);
+    for (; i + 8 <= c->n; i += 8)
+    {
+        __m256i pts = _mm256_loadu_si256((const __m256i *)(c->ptsX100 + i));
+        __m256i crd = _mm256_loadu_si256((const __m256i *)(c->credX100 + i));
+        __m256i val = _mm256_loadu_si256((const __m256i *)(c->valid + i));
+        __m256i m = _mm256_and_si256(_mm256_cmpgt_epi32(pts, ungraded), val);
+        _mm256_storeu_si256((__m256i *)q, _mm256_and_si256(_mm256_mullo_epi32(pts, crd), m));
+        _mm256_storeu_si256((__m256i *)cr, _mm256_and_si256(crd, m));
+        _mm256_storeu_si256((__m256i *)gr, _mm256_and_si256(m, one));
+        for (int k = 0; k < 8; k++) // AVX2 has no scatter: add lanes back one by one
+        {
+            int32_t g = c->group[i + k];
+            qp[g] += q[k];
+            cred[g] += cr[k];
+            graded[g] += gr[k];
+        }
+    }
+    return i;
+}
+#endif
+
+const char *gpa_kernel_name()
+{
+#ifdef GPA_KERNEL_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return "avx2";
+#endif
+    return "scalar";
+}
+
+/* qp/cred/graded are indexed by group and must be zeroed by the caller */
+void gpa_kernel(const GpaColumns *c, int64_t *qp, int64_t *cred, int32_t *graded)
+{
+    int32_t i = 0;
+#ifdef GPA_KERNEL_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        i = gpa_kernel_avx2(c, qp, cred, graded);
+#endif
+    for (; i < c->n; i++)
+    {
+        int32_t m = -(int32_t)(c->ptsX100[i] >= 0) & c->valid[i];
+        int32_t g = c->group[i];
+        qp[g] += (c->ptsX100[i] * c->credX100[i]) & m;
+        cred[g] += c->credX100[i] & m;
+        graded[g] += m & 1;
+    }
+}
+
+/* ======== TERM ARCHIVE ========
+ * Once a term is closed (every grade posted) its enrollments never change,
+ * yet every transcript still reads them.  Admin > Archive Closed Term moves
+ * a term out of enrollments.dat into an immutable segment,
+ * archive/<term>.seg:
+ *
+ *   SegHeader | SegBlock[nBlocks] | compressed blocks
+ *
+ * Rows are sorted by student and cut into blocks of SEG_BLOCK_ROWS.  Each
+ * block stores its rows column by column (student IDs, course codes,
+ * grades; the term is in the header) and is compressed with a small
+ * LZ4-style codec (byte-aligned literals and 16-bit back references, fast
+ * to decode).  Each index entry carries the block's min/max student ID,
+ * so a transcript reads only the blocks that can hold that student.
+ * archive.cat lists the archived terms.  Term names are made file-safe
+ * with unique_filename, so terms differing only in punctuation keep
+ * separate segments; the header names the term, and seg_read checks it.
+ *
+ * Archiving writes the segment and then the catalog entry, and then
+ * replaces enrollments.dat.  If a run is interrupted it can be repeated.
+ * Live rows of a term that is already cataloged are only removed once the
+ * segment holds each of them (same student, course and grade).  Rows it
+ * does not hold, such as ones appended later by another process or an
+ * older binary, are first merged into a new segment for the term.
+ */
+#define SEG_MAGIC 0x47455355u // "USEG"
+#define SEG_VERSION 1
+#define SEG_BLOCK_ROWS 512
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+
+typedef struct
+{
+    uint32_t magic, version;
+    char term[MAX_TERM];
+    int32_t nRows, nBlocks;
+} SegHeader;
+
+typedef struct
+{
+    char minSid[MAX_ID], maxSid[MAX_ID];
+    int32_t nRows;
+    uint32_t rawLen, compLen;
+    int64_t offset;
+} SegBlock;
+
+typedef struct
+{
+    char term[MAX_TERM];
+    int32_t nRows;
+    int64_t fileBytes; // segment size on disk
+} ArchiveEntry;
+
+uint32_t lz_read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+size_t lz_put_len(unsigned char *p, size_t len)
+{
+    size_t k = 0;
+    for (; len >= 255; len -= 255)
+        p[k++] = 255;
+    p[k++] = (unsigned char)len;
+    return k;
+}
+
+/* Compress n bytes; returns the compressed size, 0 if cap is too small.
+ * Sequence: token (literal len << 4 | match len - 4), extra length bytes,
+ * literals, 16-bit offset, extra match length bytes.  The last sequence is
+ * literals only. */
+size_t lz_compress(const unsigned char *src, size_t n, unsigned char *dst, size_t cap)
+{
+    int32_t table[1 << LZ_HASH_BITS];
+    for (int i = 0; i < (1 << LZ_HASH_BITS); i++)
+        table[i] = -1;
+    size_t ip = 0, anchor = 0, op = 0;
+    while (ip + LZ_MIN_MATCH <= n)
+    {
+        uint32_t v = lz_read32(src + ip);
+        unsigned h = (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+        int32_t ref = table[h];
+        table[h] = (int32_t)ip;
+        if (ref < 0 || ip - (size_t)ref > 65535 || lz_read32(src + ref) != v)
+        {
+            ip++;
+            continue;
+        }
+        size_t mlen = LZ_MIN_MATCH;
+        while (ip + mlen < n && src[ref + mlen] == src[ip + mlen])
+            mlen++;
+        size_t lit = ip - anchor, ml = mlen - LZ_MIN_MATCH;
+        if (op + 1 + lit / 255 + 1 + lit + 2 + ml / 255 + 1 > cap)
+            return 0;
+        unsigned char *tok = dst + op++;
+        *tok = (unsigned char)((lit >= 15 ? 15 : lit) << 4 | (ml >= 15 ? 15 : ml));
+        if (lit >= 15)
+            op += lz_put_len(dst + op, lit - 15);
+        memcpy(dst + op, src + anchor, lit);
+        op += lit;
+        size_t off = ip - (size_t)ref;
+        dst[op++] = (unsigned char)(off & 255);
+        dst[op++] = (unsigned char)(off >> 8);
+        if (ml >= 15)
+            op += lz_put_len(dst + op, ml - 15);
+        ip += mlen;
+        anchor = ip;
+    }
+    size_t lit = n - anchor;
+    if (op + 1 + lit / 255 + 1 + lit > cap)
+        return 0;
+    dst[op++] = (unsigned char)((lit >= 15 ? 15 : lit) << 4);
+    if (lit >= 15)
+        op += lz_put_len(dst + op, lit - 15);
+    memcpy(dst + op, src + anchor, lit);
+    return op + lit;
+}
+
+/* Returns the decompressed size, or (size_t)-1 on malformed input */
+size_t lz_decompress(const unsigned char *src, size_t n, unsigned char *dst, size_t cap)
+{
+    size_t ip = 0, op = 0;
+    while (ip < n)
+    {
+        unsigned tok = src[ip++];
+        size_t lit = tok >> 4, ml = tok & 15;
+        if (lit == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip >= n)
+                    return (size_t)-1;
+                b = src[ip++];
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > n - ip || lit > cap - op)
+            return (size_t)-1;
+        memcpy(dst + op, src + ip, lit);
+        ip += lit;
+        op += lit;
+        if (ip == n)
+            break; // literals-only last sequence
+        if (n - ip < 2)
+            return (size_t)-1;
+        size_t off = src[ip] | (size_t)src[ip + 1] << 8;
+        ip += 2;
+        if (ml == 15)
+        {
+            unsigned char b;
+            do
+            {
+                if (ip >= n)
+                    return (size_t)-1;
+                b = src[ip++];
+                ml += b;
+            } while (b == 255);
+        }
+        ml += LZ_MIN_MATCH;
+        if (off == 0 || off > op || ml > cap - op)
+            return (size_t)-1;
+        for (size_t k = 0; k < ml; k++) // may overlap: byte by byte
+            dst[op + k] = dst[op - off + k];
+        op += ml;
+    }
+    return op;
+}
+
+/* Column layout of one block: NUL-terminated IDs, then codes, then
+ * 2-byte grades.  Returns the raw length. */
+size_t seg_pack(const Enrollment *rows, int n, unsigned char *out)
+{
+    size_t k = 0;
+    for (int i = 0; i < n; i++)
+    {
+        size_t len = strnlen(rows[i].studentId, MAX_ID - 1);
+        memcpy(out + k, rows[i].studentId, len);
+        k += len;
+        out[k++] = 0;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        size_t len = strnlen(rows[i].courseCode, MAX_CODE - 1);
+        memcpy(out + k, rows[i].courseCode, len);
+        k += len;
+        out[k++] = 0;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        out[k++] = (unsigned char)rows[i].grade[0];
+        out[k++] = (unsigned char)rows[i].grade[1];
+    }
+    return k;
+}
+
+int seg_unpack(const unsigned char *in, size_t len, int n, const char *term, Enrollment *rows)
+{
+    size_t k = 0;
+    memset(rows, 0, (size_t)n * sizeof(Enrollment));
+    for (int col = 0; col < 2; col++)
+        for (int i = 0; i < n; i++)
+        {
+            char *dst = col == 0 ? rows[i].studentId : rows[i].courseCode;
+            size_t j = 0;
+            while (k < len && in[k] && j + 1 < MAX_ID)
+                dst[j++] = (char)in[k++];
+            if (k >= len || in[k])
+                return 0;
+            k++;
+        }
+    if (len - k != (size_t)n * 2)
+        return 0;
+    for (int i = 0; i < n; i++)
+    {
+        rows[i].grade[0] = (char)in[k++];
+        rows[i].grade[1] = (char)in[k++];
+        snprintf(rows[i].term, MAX_TERM, "%s", term);
+    }
+    return 1;
+}
+
+/* "Fall 2024" and "Fall_2024" are different terms and get different files */
+void archive_seg_path(const char *term, char *out, size_t cap)
+{
+    char name[MAX_TERM + 18];
+    unique_filename(term, name, sizeof(name));
+    snprintf(out, cap, "%s/%s.seg", FILE_ARCHIVE, name);
+}
+
+/* Catalog entry of term, or -1 */
+long archive_find(const char *term, ArchiveEntry *out)
+{
+    ArchiveEntry e;
+    OPEN_BIN_READ(FILE_ARCH_CAT, fp);
+    if (!fp)
+        return -1;
+    long idx = 0;
+    while (fread(&e, sizeof(e), 1, fp) == 1)
+    {
+        if (strcmp(e.term, term) == 0)
+        {
+            fclose(fp);
+            if (out)
+                *out = e;
+            return idx;
+        }
+        idx++;
+    }
+    fclose(fp);
+    return -1;
+}
+
+int cmp_enr_student_code(const void *a, const void *b)
+{
+    const Enrollment *x = (const Enrollment *)a, *y = (const Enrollment *)b;
+    int c = strcmp(x->studentId, y->studentId);
+    return c ? c : strcmp(x->courseCode, y->courseCode);
+}
+
+/* Write rows (sorted by student) as a segment; returns bytes written or -1 */
+long seg_write(const char *path, const char *term, const Enrollment *rows, int n)
+{
+    int nb = (n + SEG_BLOCK_ROWS - 1) / SEG_BLOCK_ROWS;
+    SegHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SEG_MAGIC;
+    h.version = SEG_VERSION;
+    snprintf(h.term, MAX_TERM, "%s", term);
+    h.nRows = n;
+    h.nBlocks = nb;
+    size_t rawCap = (size_t)SEG_BLOCK_ROWS * (MAX_ID + MAX_CODE + 2);
+    size_t compCap = rawCap + rawCap / 255 + 16;
+    SegBlock *idx = (SegBlock *)calloc(nb ? (size_t)nb : 1, sizeof(SegBlock));
+    unsigned char *raw = (unsigned char *)malloc(rawCap), *comp = (unsigned char *)malloc(compCap);
+    OPEN_BIN_WRITE(path, fp);
+    int ok = idx && raw && comp && fp && fwrite(&h, sizeof(h), 1, fp) == 1 &&
+             fwrite(idx, sizeof(SegBlock), (size_t)nb, fp) == (size_t)nb; // index placeholder
+    long pos = (long)(sizeof(h) + (size_t)nb * sizeof(SegBlock));
+    for (int b = 0; ok && b < nb; b++)
+    {
+        const Enrollment *r = rows + (size_t)b * SEG_BLOCK_ROWS;
+        int m = n - b * SEG_BLOCK_ROWS < SEG_BLOCK_ROWS ? n - b * SEG_BLOCK_ROWS : SEG_BLOCK_ROWS;
+        size_t rawLen = seg_pack(r, m, raw);
+        size_t compLen = lz_compress(raw, rawLen, comp, compCap);
+        ok = compLen > 0 && fwrite(comp, 1, compLen, fp) == compLen;
+        snprintf(idx[b].minSid, MAX_ID, "%s", r[0].studentId);
+        snprintf(idx[b].maxSid, MAX_ID, "%s", r[m - 1].studentId);
+        idx[b].nRows = m;
+        idx[b].rawLen = (uint32_t)rawLen;
+        idx[b].compLen = (uint32_t)compLen;
+        idx[b].offset = pos;
+        pos += (long)compLen;
+    }
+    ok = ok && fseek(fp, (long)sizeof(h), SEEK_SET) == 0 && fwrite(idx, sizeof(SegBlock), (size_t)nb, fp) == (size_t)nb;
+    ok = ok && fflush(fp) == 0 && (g_cfg.fsyncPolicy != FSYNC_ALWAYS || FSYNC(fp) == 0);
+    if (fp && fclose(fp) != 0)
+        ok = 0;
+    free(idx);
+    free(raw);
+    free(comp);
+    return ok ? pos : -1;
+}
+
+/* Append the rows of one segment (only blocks that can hold sid, if given) */
+int seg_read(const char *term, const char *sid, Enrollment **out, long *n, long *cap)
+{
+    char path[MAX_PATH_LEN + 48];
+    archive_seg_path(term, path, sizeof(path));
+    OPEN_BIN_READ(path, fp);
+    if (!fp)
+    {
+        // segments written before unique names: the header term tells them apart
+        char name[MAX_TERM];
+        safe_filename(term, name, sizeof(name));
+        snprintf(path, sizeof(path), "%s/%s.seg", FILE_ARCHIVE, name);
+        fp = fopen(path, "rb");
+        if (!fp)
+            return 0;
+    }
+    trace_begin("storage", "seg_read", "%s", term);
+    SegHeader h;
+    SegBlock *idx = NULL;
+    unsigned char *raw = NULL, *comp = NULL;
+    int ok = fread(&h, sizeof(h), 1, fp) == 1 && h.magic == SEG_MAGIC && h.version == SEG_VERSION &&
+             memchr(h.term, 0, MAX_TERM) && strcmp(h.term, term) == 0 && h.nBlocks >= 0 && h.nBlocks <= 1 << 20;
+    if (ok)
+    {
+        idx = (SegBlock *)malloc((h.nBlocks ? (size_t)h.nBlocks : 1) * sizeof(SegBlock));
+        ok = idx && fread(idx, sizeof(SegBlock), (size_t)h.nBlocks, fp) == (size_t)h.nBlocks;
+    }
+    size_t rawCap = (size_t)SEG_BLOCK_ROWS * (MAX_ID + MAX_CODE + 2);
+    raw = (unsigned char *)malloc(rawCap);
+    comp = (unsigned char *)malloc(rawCap + rawCap / 255 + 16);
+    ok = ok && raw && comp;
+    long blocksRead = 0, bytes = 0;
+    for (int b = 0; ok && b < h.nBlocks; b++)
+    {
+        const SegBlock *sb = &idx[b];
+        if (!memchr(sb->minSid, 0, MAX_ID) || !memchr(sb->maxSid, 0, MAX_ID))
+        {
+            ok = 0;
+            break;
+        }
+        if (sid && (strcmp(sid, sb->minSid) < 0 || strcmp(sid, sb->maxSid) > 0))
+            continue; // block index: this block cannot hold the student
+        ok = sb->nRows > 0 && sb->nRows <= SEG_BLOCK_ROWS && sb->rawLen <= rawCap &&
+             sb->compLen <= rawCap + rawCap / 255 + 16 && fseek(fp, (long)sb->offset, SEEK_SET) == 0 &&
+             fread(comp, 1, sb->compLen, fp) == sb->compLen &&
+             lz_decompress(comp, sb->compLen, raw, sb->rawLen) == sb->rawLen;
+        if (ok && *n + sb->nRows > *cap)
+        {
+            long nc = *cap ? *cap : 64;
+            while (nc < *n + sb->nRows)
+                nc *= 2;
+            Enrollment *p = (Enrollment *)realloc(*out, (size_t)nc * sizeof(Enrollment));
+            ok = p != NULL;
+            if (ok)
+            {
+                *out = p;
+                *cap = nc;
+            }
+        }
+        ok = ok && seg_unpack(raw, sb->rawLen, sb->nRows, h.term, *out + *n);
+        if (!ok)
+            break;
+        if (sid) // keep only this student's rows
+        {
+            long keep = *n;
+            for (int i = 0; i < sb->nRows; i++)
+                if (strcmp((*out)[*n + i].studentId, sid) == 0)
+                    (*out)[keep++] = (*out)[*n + i];
+            *n = keep;
+        }
+        else
+            *n += sb->nRows;
+        blocksRead++;
+        bytes += (long)sb->compLen;
+    }
+    trace_io(blocksRead, bytes);
+    trace_end();
+    fclose(fp);
+    free(idx);
+    free(raw);
+    free(comp);
+    if (!ok)
+        printf("[archive] %s is damaged; its rows are missing from this report\n", path);
+    return ok;
+}
+
+/* Archived rows of one term (or all terms), optionally of one student */
+Enrollment *archive_rows(const char *term, const char *sid, long *n)
+{
+    Enrollment *out = NULL;
+    long cap = 0;
+    *n = 0;
+    if (term)
+    {
+        if (archive_find(term, NULL) >= 0)
+            seg_read(term, sid, &out, n, &cap);
+        return out;
+    }
+    long nt;
+    ArchiveEntry *cat = (ArchiveEntry *)file_load_all(FILE_ARCH_CAT, sizeof(ArchiveEntry), &nt);
+    for (long i = 0; i < nt; i++)
+        seg_read(cat[i].term, sid, &out, n, &cap);
+    free(cat);
+    return out;
+}
+
+/* Append the archived rows of sid to a malloc'd enrollment array */
+Enrollment *archive_merge_student(Enrollment *enr, long *n, const char *sid)
+{
+    long na;
+    Enrollment *arch = archive_rows(NULL, sid, &na);
+    if (!na)
+        return enr;
+    Enrollment *all = (Enrollment *)realloc(enr, (size_t)(*n + na) * sizeof(Enrollment));
+    if (all)
+    {
+        memcpy(all + *n, arch, (size_t)na * sizeof(Enrollment));
+        *n += na;
+    }
+    free(arch);
+    return all ? all : enr;
+}
+
+/* Move a closed term from enrollments.dat into an archive segment */
+void archive_term(const char *term)
+{
+    trace_args("term=%s", term);
+    long ne;
+    Enrollment *enr = (Enrollment *)file_load_all(FILE_ENR, sizeof(Enrollment), &ne);
+    long nt = 0, ungraded = 0;
+    for (long i = 0; i < ne; i++)
+        if (strcmp(enr[i].term, term) == 0)
+        {
+            nt++;
+            ungraded += grade_to_points_x100(enr[i].grade) < 0;
+        }
+    ArchiveEntry ce;
+    long cat = archive_find(term, &ce);
+    if (!nt)
+    {
+        printf(cat >= 0 ? "%s is already archived.\n" : "No enrollments in %s.\n", term);
+        free(enr);
+        return;
+    }
+    if (ungraded)
+    {
+        printf("%s is not closed: %ld enrollment(s) have no grade.\n", term, ungraded);
+        free(enr);
+        return;
+    }
+    // an archived term with live rows: an interrupted run, or rows added since
+    Enrollment *old = NULL;
+    long nOld = 0, capOld = 0;
+    if (cat >= 0 && !seg_read(term, NULL, &old, &nOld, &capOld))
+    {
+        free(old);
+        free(enr);
+        printf("The archive of %s cannot be read; enrollments.dat was left alone.\n", term);
+        return;
+    }
+    if (old)
+        qsort(old, (size_t)nOld, sizeof(Enrollment), cmp_enr_student_code);
+    // partition: term rows to the front (sorted by student), the rest keep their order
+    Enrollment *rows = (Enrollment *)malloc((size_t)ne * sizeof(Enrollment));
+    if (!rows)
+    {
+        free(old);
+        free(enr);
+        printf("Out of memory.\n");
+        return;
+    }
+    long a = 0, b = nt;
+    for (long i = 0; i < ne; i++)
+        rows[strcmp(enr[i].term, term) == 0 ? a++ : b++] = enr[i];
+    free(enr);
+    qsort(rows, (size_t)nt, sizeof(Enrollment), cmp_enr_student_code);
+    long fresh = 0; // live rows the segment does not hold as they are
+    for (long i = 0; i < nt; i++)
+    {
+        const Enrollment *o =
+            old ? (const Enrollment *)bsearch(&rows[i], old, (size_t)nOld, sizeof(Enrollment), cmp_enr_student_code)
+                : NULL;
+        fresh += !o || strcmp(o->grade, rows[i].grade) != 0;
+    }
+
+    char seg[MAX_PATH_LEN + 48], tmp[MAX_PATH_LEN + 52];
+    long segBytes = 0, nSeg = nOld;
+    if (fresh) // write the term's segment: the live rows, plus archived ones they do not replace
+    {
+        Enrollment *all = (Enrollment *)malloc((size_t)(nt + nOld + 1) * sizeof(Enrollment));
+        if (!all)
+        {
+            free(old);
+            free(rows);
+            printf("Out of memory.\n");
+            return;
+        }
+        memcpy(all, rows, (size_t)nt * sizeof(Enrollment));
+        nSeg = nt;
+        for (long i = 0; i < nOld; i++)
+            if (!bsearch(&old[i], rows, (size_t)nt, sizeof(Enrollment), cmp_enr_student_code))
+                all[nSeg++] = old[i];
+        qsort(all, (size_t)nSeg, sizeof(Enrollment), cmp_enr_student_code);
+        MKDIR(FILE_ARCHIVE);
+        archive_seg_path(term, seg, sizeof(seg));
+        snprintf(tmp, sizeof(tmp), "%s.tmp", seg);
+        segBytes = seg_write(tmp, term, all, (int)nSeg);
+        free(all);
+        memset(&ce, 0, sizeof(ce));
+        snprintf(ce.term, MAX_TERM, "%s", term);
+        ce.nRows = (int32_t)nSeg;
+        ce.fileBytes = segBytes;
+        // the old segment holds a subset, so a crash after the rename loses nothing
+        if (segBytes < 0 || rename(tmp, seg) != 0 ||
+            !(cat >= 0 ? file_write_at(FILE_ARCH_CAT, sizeof(ce), cat, &ce)
+                       : file_append(FILE_ARCH_CAT, sizeof(ce), &ce)))
+        {
+            remove(tmp);
+            free(old);
+            free(rows);
+            printf("Could not write the archive segment; enrollments.dat was left alone.\n");
+            return;
+        }
+    }
+    free(old);
+    // live file without the term: temp + rename
+    snprintf(tmp, sizeof(tmp), "%s.tmp", FILE_ENR);
+    OPEN_BIN_WRITE(tmp, fp);
+    int ok = fp && fwrite(rows + nt, sizeof(Enrollment), (size_t)(ne - nt), fp) == (size_t)(ne - nt);
+    ok = ok && fflush(fp) == 0 && (g_cfg.fsyncPolicy != FSYNC_ALWAYS || FSYNC(fp) == 0);
+    if (fp && fclose(fp) != 0)
+        ok = 0;
+    free(rows);
+    if (!ok || rename(tmp, FILE_ENR) != 0)
+    {
+        remove(tmp);
+        printf("Segment written but enrollments.dat was not updated; run Archive again to finish.\n");
+        return;
+    }
+    // record numbers moved: derived caches start over
+    tenant_drop_caches(0);
+    remove(FILE_ADJ);
+    remove(FILE_ZONES);
+    if (!fresh)
+        printf("Finished archiving %s: removed %ld live row(s) already in the archive.\n", term, nt);
+    else if (cat >= 0)
+        printf("Added %ld new row(s) to the archive of %s (%ld rows).\n", fresh, term, nSeg);
+    else
+        printf("Archived %ld enrollment(s) of %s: %.1f KB -> %.1f KB (%.1fx)\n", nt, term,
+               nt * (double)sizeof(Enrollment) / 1024.0, segBytes / 1024.0,
+               segBytes ? nt * (double)sizeof(Enrollment) / segBytes : 0.0);
+}
+
+void archive_stats()
+{
+    long nt;
+    ArchiveEntry *cat = (ArchiveEntry *)file_load_all(FILE_ARCH_CAT, sizeof(ArchiveEntry), &nt);
+    long rows = 0;
+    double bytes = 0;
+    for (long i = 0; i < nt; i++)
+    {
+        rows += cat[i].nRows;
+        bytes += (double)cat[i].fileBytes;
+    }
+    free(cat);
+    printf("Archived terms: %ld (%ld rows, %.1f KB on disk, %.1f KB as records)\n", nt, rows, bytes / 1024.0,
+           rows * (double)sizeof(Enrollment) / 1024.0);
+}
+
+/* ======== DOMAIN LOGIC ======== */
+void print_student(const Student *s)
+{
+    printf("ID: %s | Name: %s | Dept: %s | Batch: %d | Email: %s\n", s->id, s->name, s->dept, s->batch, s->email);
+}
+
+void print_faculty(const Faculty *f)
+{
+    printf("ID: %s | Name: %s | Dept: %s | Email: %s\n", f->id, f->name, f->dept, f->email);
+}
+
+void print_course(const Course *c)
+{
+    printf("Code: %s | Title: %s | Credit: %.1f | Dept: %s | Instructor: %s\n",
+           c->code, c->title, c->credit, c->dept, c->instructorId);
+}
+
+void print_enr(const Enrollment *e)
+{
+    printf("Student: %s | Course: %s | Term: %s | Grade: %s\n", e->studentId, e->courseCode, e->term, e->grade);
+}
+
+/* ======== CRUD ======== */
+void add_student()
+{
+    Student s = {0};
+    read_line("Student ID: ", s.id, sizeof(s.id));
+    if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, s.id, NULL) >= 0)
+    {
+        printf("Student with this ID already exists.\n");
+        return;
+    }
+    read_line("Name: ", s.name, sizeof(s.name));
+    read_line("Dept (EEE/CSE...): ", s.dept, sizeof(s.dept));
+    s.batch = read_int("Batch (e.g., 241): ");
+    if (s.batch <= 0)
+    {
+        printf("Invalid batch.\n");
+        return;
+    }
+    read_line("Email: ", s.email, sizeof(s.email));
     if (file_append(FILE_STUD, sizeof(Student), &s))
+    {
+        on_student_changed(&s);
         printf("Student added.\n");
+    }
+    else
+        printf("Error writing student file.\n");
+}
+
+void edit_student()
+{
+    char id[MAX_ID];
+    read_line("Enter Student ID to edit: ", id, sizeof(id));
+    Student s;
+    long idx = file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, id, &s);
+    if (idx < 0)
+    {
+        printf("Not found.\n");
+        return;
+    }
+    print_student(&s);
+    printf("Leave blank to keep existing.\n");
+    char buf[128];
+    // snprintf, not strncpy: the buffer is longer than the fields
+    read_line("New name: ", buf, sizeof(buf));
+    if (strlen(buf))
+        snprintf(s.name, MAX_NAME, "%.*s", MAX_NAME - 1, buf);
+    read_line("New dept: ", buf, sizeof(buf));
+    if (strlen(buf))
+        snprintf(s.dept, MAX_DEPT, "%.*s", MAX_DEPT - 1, buf);
+    read_line("New email: ", buf, sizeof(buf));
+    if (strlen(buf))
+        snprintf(s.email, MAX_EMAIL, "%.*s", MAX_EMAIL - 1, buf);
+    buf[0] = 0;
+    read_line("New batch (empty to keep): ", buf, sizeof(buf));
+    int batch;
+    if (strlen(buf) && parse_int(buf, &batch) && batch > 0)
+        s.batch = batch;
+    else if (strlen(buf))
+        printf("Invalid batch, keeping %d.\n", s.batch);
+    if (file_write_at(FILE_STUD, sizeof(Student), idx, &s))
+    {
+        on_student_changed(&s);
+        printf("Updated.\n");
+    }
+    else
+        printf("Write error.\n");
+}
+
+void list_students()
+{
+    OPEN_BIN_READ(FILE_STUD, fp);
+    if (!fp)
+    {
+        printf("No students yet.\n");
+        return;
+    }
+    char dept[MAX_DEPT];
+    read_line("Dept (blank = all): ", dept, sizeof(dept));
+    Student s;
+    int32_t n;
+    const IdxEntry *inDept = dept[0] ? index_range(IDX_STUDENT_DEPT, dept, &n) : NULL;
+    printf("\n-- Students --\n");
+    for (int32_t i = 0; inDept && i < n; i++)
+        if (fseek(fp, (long)inDept[i].ref * (long)sizeof(Student), SEEK_SET) == 0 &&
+            fread(&s, sizeof(Student), 1, fp) == 1 && strcmp(s.dept, dept) == 0)
+        {
+            trace_io(1, (long)sizeof(Student));
+            print_student(&s);
+        }
+    while (!inDept && fread(&s, sizeof(Student), 1, fp) == 1)
+    {
+        trace_io(1, (long)sizeof(Student));
+        if (!dept[0] || strcmp(s.dept, dept) == 0)
+            print_student(&s);
+    }
+    fclose(fp);
+}
+
+void add_faculty()
+{
+    Faculty f = {0};
+    read_line("Faculty ID: ", f.id, sizeof(f.id));
+    if (file_find_first(FILE_FAC, sizeof(Faculty), pred_faculty_by_id, f.id, NULL) >= 0)
+    {
+        printf("Faculty exists.\n");
+        return;
+    }
+    read_line("Name: ", f.name, sizeof(f.name));
+    read_line("Dept: ", f.dept, sizeof(f.dept));
+    read_line("Email: ", f.email, sizeof(f.email));
+    if (file_append(FILE_FAC, sizeof(Faculty), &f))
+        printf("Faculty added.\n");
+    else
+        printf("Write error.\n");
+}
+
+void list_faculty()
+{
+    OPEN_BIN_READ(FILE_FAC, fp);
+    if (!fp)
+    {
+        printf("No faculty yet.\n");
+        return;
+    }
+    Faculty f;
+    printf("\n-- Faculty --\n");
+    while (fread(&f, sizeof(Faculty), 1, fp) == 1)
+    {
+        trace_io(1, (long)sizeof(Faculty));
+        print_faculty(&f);
+    }
+    fclose(fp);
+}
+
+void add_course()
+{
+    Course c = {0};
+    read_line("Course code (e.g., EEE-2101): ", c.code, sizeof(c.code));
+    if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, c.code, NULL) >= 0)
+    {
+        printf("Course exists.\n");
+        return;
+    }
+    read_line("Title: ", c.title, sizeof(c.title));
+    c.credit = read_float("Credit (e.g., 3): ");
+    if (c.credit <= 0 || c.credit > 30)
+    {
+        printf("Invalid credit.\n");
+        return;
+    }
+    read_line("Dept: ", c.dept, sizeof(c.dept));
+    read_line("Instructor ID (optional, blank to skip): ", c.instructorId, sizeof(c.instructorId));
+    if (file_append(FILE_COURSE, sizeof(Course), &c))
+    {
+        on_course_changed(c.code);
+        printf("Course added.\n");
+    }
+    else
+        printf("Write error.\n");
+}
+
+void assign_instructor()
+{
+    char code[MAX_CODE], fid[MAX_ID];
+    read_line("Course code: ", code, sizeof(code));
+    Course c;
+    long idx = file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, code, &c);
+    if (idx < 0)
+    {
+        printf("Course not found.\n");
+        return;
+    }
+    read_line("Faculty ID: ", fid, sizeof(fid));
+    if (file_find_first(FILE_FAC, sizeof(Faculty), pred_faculty_by_id, fid, NULL) < 0)
+    {
+        printf("Faculty not found.\n");
+        return;
+    }
+    strncpy(c.instructorId, fid, MAX_ID);
+    if (file_write_at(FILE_COURSE, sizeof(Course), idx, &c))
+    {
+        on_course_changed(c.code);
+        printf("Instructor assigned.\n");
+    }
+    else
+        printf("Write error.\n");
+}
+
+void list_courses()
+{
+    OPEN_BIN_READ(FILE_COURSE, fp);
+    if (!fp)
+    {
+        printf("No courses yet.\n");
+        return;
+    }
+    Course c;
+    printf("\n-- Courses --\n");
+    while (fread(&c, sizeof(Course), 1, fp) == 1)
+    {
+        trace_io(1, (long)sizeof(Course));
+        print_course(&c);
+    }
+    fclose(fp);
+}
+
+Course *courses_load_sorted(long *n);
+const Course *course_lookup(const Course *cs, long n, const char *code);
+
+/* Registration cart: a student's course requests for one term are staged,
+ * validated together (one student lookup, one course table load, one
+ * probe of the student's and of each course's enrollment list) and then
+ * committed as a single batch write.  Nothing is written unless every
+ * line passes.  There is no timetable data, so clashes cannot be checked.
+ */
+enum
+{
+    CART_OK,
+    CART_NO_COURSE,
+    CART_ENROLLED, // already enrolled this term
+    CART_REPEATED, // same course twice in the cart
+    CART_FULL,     // course_capacity reached
+    CART_CLOSED    // term is archived
+};
+static const char *CART_STATUS[] = {"ok",          "course not found", "already enrolled",
+                                    "listed twice", "course full",      "term is closed"};
+
+typedef struct
+{
+    char sid[MAX_ID];
+    char term[MAX_TERM];
+    char codes[CART_MAX][MAX_CODE];
+    int status[CART_MAX];
+    int n;
+} Cart;
+
+int cart_add(Cart *c, const char *code)
+{
+    if (c->n >= CART_MAX)
+        return 0;
+    snprintf(c->codes[c->n], MAX_CODE, "%.*s", MAX_CODE - 1, code);
+    c->status[c->n++] = CART_OK;
+    return 1;
+}
+
+/* Fills c->status; returns the number of lines that failed */
+int cart_validate(Cart *c)
+{
+    long nc, n;
+    Course *cs = courses_load_sorted(&nc);
+    Enrollment *mine = enr_for_key(0, c->sid, &n);
+    int closed = archive_find(c->term, NULL) >= 0;
+    int bad = 0;
+    for (int i = 0; i < c->n; i++)
+    {
+        int st = closed ? CART_CLOSED : course_lookup(cs, nc, c->codes[i]) ? CART_OK : CART_NO_COURSE;
+        for (int k = 0; k < i && st == CART_OK; k++)
+            if (strcmp(c->codes[k], c->codes[i]) == 0)
+                st = CART_REPEATED;
+        for (long k = 0; k < n && st == CART_OK; k++)
+            if (strcmp(mine[k].courseCode, c->codes[i]) == 0 && strcmp(mine[k].term, c->term) == 0)
+                st = CART_ENROLLED;
+        if (st == CART_OK && g_cfg.courseCapacity > 0)
+        {
+            long m, seats = 0;
+            Enrollment *roster = enr_for_key(1, c->codes[i], &m);
+            for (long k = 0; k < m; k++)
+                seats += strcmp(roster[k].term, c->term) == 0;
+            free(roster);
+            if (seats >= g_cfg.courseCapacity)
+                st = CART_FULL;
+        }
+        c->status[i] = st;
+        bad += st != CART_OK;
+    }
+    free(mine);
+    free(cs);
+    return bad;
+}
+
+/* Validate and write the whole cart; 1 when every course was enrolled */
+int cart_commit(Cart *c)
+{
+    trace_args("sid=%s term=%s n=%d", redact_id(c->sid), c->term, c->n);
+    if (c->n == 0 || cart_validate(c) > 0)
+        return 0;
+    Enrollment batch[CART_MAX];
+    memset(batch, 0, sizeof(batch));
+    for (int i = 0; i < c->n; i++)
+    {
+        strcpy(batch[i].studentId, c->sid);
+        strcpy(batch[i].courseCode, c->codes[i]);
+        strcpy(batch[i].term, c->term);
+        strcpy(batch[i].grade, "NA");
+    }
+    long ref = file_count_records(FILE_ENR, sizeof(Enrollment));
+    if (!file_append_batch(FILE_ENR, sizeof(Enrollment), batch, (size_t)c->n))
+        return 0;
+    for (int i = 0; i < c->n; i++)
+        on_enrollment_appended(&batch[i], ref + i);
+    return 1;
+}
+
+void enroll_student()
+{
+    Cart c = {0};
+    read_line("Student ID: ", c.sid, sizeof(c.sid));
+    if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, c.sid, NULL) < 0)
+    {
+        printf("Student not found.\n");
+        return;
+    }
+    char code[MAX_CODE];
+    read_line("Course code: ", code, sizeof(code));
+    if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, code, NULL) < 0)
+    {
+        printf("Course not found.\n");
+        return;
+    }
+    read_line("Term (e.g., Fall-2025): ", c.term, sizeof(c.term));
+    cart_add(&c, code);
+    if (cart_commit(&c))
+        printf("Enrollment added.\n");
+    else if (c.status[0] == CART_ENROLLED)
+        printf("Already enrolled.\n");
+    else if (c.status[0] != CART_OK)
+        printf("Cannot enroll: %s.\n", CART_STATUS[c.status[0]]);
+    else
+        printf("Write error.\n");
+}
+
+/* Interactive cart for one student (admin passes NULL to ask for the ID) */
+void register_courses(const char *sid)
+{
+    Cart c = {0};
+    if (sid)
+        snprintf(c.sid, sizeof(c.sid), "%s", sid);
+    else
+        read_line("Student ID: ", c.sid, sizeof(c.sid));
+    if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, c.sid, NULL) < 0)
+    {
+        printf("Student not found.\n");
+        return;
+    }
+    read_line("Term (e.g., Fall-2025): ", c.term, sizeof(c.term));
+    if (!c.term[0])
+        return;
+    printf("Enter course codes, one per line (blank line to finish, up to %d).\n", CART_MAX);
+    char code[MAX_CODE];
+    while (c.n < CART_MAX)
+    {
+        read_line("Course code: ", code, sizeof(code));
+        if (!code[0])
+            break;
+        cart_add(&c, code);
+    }
+    if (c.n == 0)
+    {
+        printf("Cart is empty.\n");
+        return;
+    }
+    if (cart_validate(&c) > 0)
+    {
+        printf("Nothing was registered:\n");
+        for (int i = 0; i < c.n; i++)
+            printf("  %-10s %s\n", c.codes[i], CART_STATUS[c.status[i]]);
+        return;
+    }
+    printf("\n-- Cart for %s (%s) --\n", c.sid, c.term);
+    for (int i = 0; i < c.n; i++)
+        printf("  %s\n", c.codes[i]);
+    char yn[8];
+    read_line("Register all? (y/n): ", yn, sizeof(yn));
+    if (yn[0] != 'y' && yn[0] != 'Y')
+    {
+        printf("Cart discarded.\n");
+        return;
+    }
+    // validated again inside commit: another session may have filled a seat
+    if (cart_commit(&c))
+        printf("Registered %d course(s).\n", c.n);
+    else
+        printf("Registration failed; nothing was written.\n");
+}
+
+void set_grade()
+{
+    Enrollment e;
+    char sid[MAX_ID], code[MAX_CODE], term[MAX_TERM], g[3];
+    read_line("Student ID: ", sid, sizeof(sid));
+    read_line("Course code: ", code, sizeof(code));
+    read_line("Term: ", term, sizeof(term));
+    trace_args("sid=%s code=%s term=%s", redact_id(sid), code, term);
+    EnrKey key;
+    strncpy(key.sid, sid, MAX_ID);
+    strncpy(key.code, code, MAX_CODE);
+    strncpy(key.term, term, MAX_TERM);
+    long idx = file_find_first(FILE_ENR, sizeof(Enrollment), pred_enr_by_key, &key, &e);
+    if (idx < 0)
+    {
+        printf("Enrollment not found.\n");
+        return;
+    }
+    read_line("Grade (A, A-, B+, ... , F): ", g, sizeof(g));
+    upper(g);
+    if (grade_to_points(g) < 0 && strcmp(g, "NA") != 0)
+    {
+        printf("Invalid grade.\n");
+        return;
+    }
+    strncpy(e.grade, g, 2);
+    e.grade[2] = 0;
+    if (file_write_at(FILE_ENR, sizeof(Enrollment), idx, &e))
+    {
+        on_grade_changed(&e);
+        printf("Grade updated.\n");
+    }
+    else
+        printf("Write error.\n");
+}
+
+/* ======== BULK OPERATIONS ========
+ * Admin > Bulk Import loads a CSV file (no quoting, '#' lines ignored):
+ *
+ *   students     id,name,dept,batch,email
+ *   enrollments  sid,code,term
+ *   grades       sid,code,term,grade
+ *   learners     student_records.txt of the Learner program
+ *                (roll,fullname,cgpa,sex), see bulk_prepare_learners
+ *
+ * Rows are committed in batches of bulk_batch: one batch append per
+ * table, then the change hooks, then a checkpoint (bulk.ckpt) holding the
+ * input offset, line and last committed key.  If a run dies, the next run
+ * on the same input resumes at the checkpoint.  Every row also carries an
+ * idempotency key (student ID, or sid|code|term), and rows whose key is
+ * already stored are skipped.  So rows that were committed after the last
+ * checkpoint are not appended twice, and re-running a finished file is a
+ * no-op.  Grades are idempotent by nature (set, not add).
+ */
+#define BULK_MAGIC 0x4B4C5555u // "UULK"
+#define BULK_LINE 512
+#define BULK_KEY 48
+
+typedef struct
+{
+    uint32_t magic;
+    char kind[16];
+    char input[MAX_PATH_LEN];
+    int64_t inputSize; // same file, same size: safe to resume
+    int64_t offset;    // first byte not yet committed
+    int64_t line;
+    char lastKey[BULK_KEY];
+    int64_t added, skipped, bad;
+    char opts[64]; // kind options, reused on resume
+} BulkCheckpoint;
+
+/* Set of 64-bit key hashes (open addressing, 0 = empty).  A hit is only a
+ * candidate: the kind confirms it against the stored data. */
+typedef struct
+{
+    uint64_t *slot;
+    size_t cap, n;
+} KeySet;
+
+int keyset_add(KeySet *ks, uint64_t h)
+{
+    h = h ? h : 1;
+    if ((ks->n + 1) * 2 > ks->cap)
+    {
+        size_t cap = ks->cap ? ks->cap * 2 : 1024;
+        uint64_t *ns = (uint64_t *)calloc(cap, sizeof(uint64_t));
+        if (!ns)
+            return 0;
+        for (size_t i = 0; i < ks->cap; i++)
+            if (ks->slot[i])
+            {
+                size_t j = ks->slot[i] & (cap - 1);
+                while (ns[j])
+                    j = (j + 1) & (cap - 1);
+                ns[j] = ks->slot[i];
+            }
+        free(ks->slot);
+        ks->slot = ns;
+        ks->cap = cap;
+    }
+    size_t j = h & (ks->cap - 1);
+    while (ks->slot[j] && ks->slot[j] != h)
+        j = (j + 1) & (ks->cap - 1);
+    if (!ks->slot[j])
+    {
+        ks->slot[j] = h;
+        ks->n++;
+    }
+    return 1;
+}
+
+int keyset_has(const KeySet *ks, uint64_t h)
+{
+    h = h ? h : 1;
+    if (!ks->cap)
+        return 0;
+    for (size_t j = h & (ks->cap - 1); ks->slot[j]; j = (j + 1) & (ks->cap - 1))
+        if (ks->slot[j] == h)
+            return 1;
+    return 0;
+}
+
+void keyset_free(KeySet *ks)
+{
+    free(ks->slot);
+    memset(ks, 0, sizeof(*ks));
+}
+
+typedef struct BulkCtx BulkCtx;
+
+enum
+{
+    BULK_ADDED,
+    BULK_SKIPPED, // key already stored
+    BULK_BAD
+};
+
+typedef struct
+{
+    const char *name;
+    const char *format;
+    int fields;
+    int (*prepare)(BulkCtx *c);
+    int (*row)(BulkCtx *c, char **f, char *key); // BULK_*; fills key
+    const char *options;                         // prompt for kind options, NULL = none
+} BulkKind;
+
+typedef struct
+{
+    int32_t roll, line; // last line of the roll, 0 = deleted
+    int32_t seq;        // event order, to keep the last one
+} LearnerLast;
+
+struct BulkCtx
+{
+    const BulkKind *kind;
+    KeySet keys;          // idempotency keys stored or pending
+    char (*sids)[MAX_ID]; // existing student IDs, sorted
+    long nSids;
+    Course *cs;
+    long nc;
+    Student *stu; // pending appends of this batch
+    Enrollment *enr;
+    int nStu, nEnr;
+    char why[64]; // reason for the last BULK_BAD
+    const char *input, *opts;
+    long line; // input line of the current row
+    LearnerLast *last; // learners: current version of each roll
+    long nLast;
+    char dept[MAX_DEPT], batch[12], prefix[8];
+};
+
+int cmp_sid(const void *a, const void *b)
+{
+    return strcmp((const char *)a, (const char *)b);
+}
+
+int bulk_student_exists(const BulkCtx *c, const char *sid)
+{
+    return c->sids && bsearch(sid, c->sids, (size_t)c->nSids, MAX_ID, cmp_sid) != NULL;
+}
+
+/* Load student IDs (sorted) and their hashes */
+int bulk_prepare_students(BulkCtx *c)
+{
+    Student *all = (Student *)file_load_all(FILE_STUD, sizeof(Student), &c->nSids);
+    c->sids = c->nSids ? malloc((size_t)c->nSids * MAX_ID) : NULL;
+    for (long i = 0; c->sids && i < c->nSids; i++)
+    {
+        memcpy(c->sids[i], all[i].id, MAX_ID);
+        keyset_add(&c->keys, zone_hash(all[i].id));
+    }
+    free(all);
+    if (c->sids)
+        qsort(c->sids, (size_t)c->nSids, MAX_ID, cmp_sid);
+    return !c->nSids || c->sids;
+}
+
+int bulk_prepare_enrollments(BulkCtx *c)
+{
+    if (!bulk_prepare_students(c))
+        return 0;
+    keyset_free(&c->keys); // student keys are not this kind's keys
+    c->cs = courses_load_sorted(&c->nc);
+    OPEN_BIN_READ(FILE_ENR, fp);
+    if (!fp)
+        return 1;
+    Enrollment e;
+    char key[BULK_KEY];
+    while (fread(&e, sizeof(Enrollment), 1, fp) == 1)
+    {
+        snprintf(key, sizeof(key), "%s|%s|%s", e.studentId, e.courseCode, e.term);
+        keyset_add(&c->keys, zone_hash(key));
+    }
+    fclose(fp);
+    return 1;
+}
+
+int bulk_prepare_grades(BulkCtx *c)
+{
+    (void)c; // rows are looked up one by one
+    return 1;
+}
+
+int bulk_bad(BulkCtx *c, const char *why)
+{
+    snprintf(c->why, sizeof(c->why), "%s", why);
+    return BULK_BAD;
+}
+
+int bulk_row_student(BulkCtx *c, char **f, char *key)
+{
+    Student s;
+    memset(&s, 0, sizeof(s));
+    int batch;
+    if (!f[0][0] || strlen(f[0]) >= MAX_ID)
+        return bulk_bad(c, "bad student ID");
+    if (!parse_int(f[3], &batch) || batch <= 0)
+        return bulk_bad(c, "bad batch");
+    snprintf(key, BULK_KEY, "%s", f[0]);
+    uint64_t h = zone_hash(key);
+    if (keyset_has(&c->keys, h))
+    {
+        // candidate duplicate: confirm against the file and this batch
+        int dup = bulk_student_exists(c, f[0]);
+        for (int i = 0; i < c->nStu && !dup; i++)
+            dup = strcmp(c->stu[i].id, f[0]) == 0;
+        if (!dup)
+            dup = file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, f[0], NULL) >= 0;
+        if (dup)
+            return BULK_SKIPPED;
+    }
+    snprintf(s.id, MAX_ID, "%s", f[0]);
+    snprintf(s.name, MAX_NAME, "%.*s", MAX_NAME - 1, f[1]);
+    snprintf(s.dept, MAX_DEPT, "%.*s", MAX_DEPT - 1, f[2]);
+    s.batch = batch;
+    snprintf(s.email, MAX_EMAIL, "%.*s", MAX_EMAIL - 1, f[4]);
+    c->stu[c->nStu++] = s;
+    keyset_add(&c->keys, h);
+    return BULK_ADDED;
+}
+
+int bulk_row_enrollment(BulkCtx *c, char **f, char *key)
+{
+    if (strlen(f[0]) >= MAX_ID || strlen(f[1]) >= MAX_CODE || strlen(f[2]) >= MAX_TERM || !f[2][0])
+        return bulk_bad(c, "field too long or empty");
+    if (!bulk_student_exists(c, f[0]))
+        return bulk_bad(c, "student not found");
+    if (!course_lookup(c->cs, c->nc, f[1]))
+        return bulk_bad(c, "course not found");
+    if (archive_find(f[2], NULL) >= 0)
+        return bulk_bad(c, "term is closed");
+    snprintf(key, BULK_KEY, "%s|%s|%s", f[0], f[1], f[2]);
+    uint64_t h = zone_hash(key);
+    if (keyset_has(&c->keys, h))
+    {
+        int dup = 0;
+        for (int i = 0; i < c->nEnr && !dup; i++)
+            dup = strcmp(c->enr[i].studentId, f[0]) == 0 && strcmp(c->enr[i].courseCode, f[1]) == 0 &&
+                  strcmp(c->enr[i].term, f[2]) == 0;
+        long n;
+        Enrollment *mine = dup ? NULL : enr_for_key(0, f[0], &n);
+        for (long i = 0; mine && i < n && !dup; i++)
+            dup = strcmp(mine[i].courseCode, f[1]) == 0 && strcmp(mine[i].term, f[2]) == 0;
+        free(mine);
+        if (dup)
+            return BULK_SKIPPED;
+    }
+    Enrollment *e = &c->enr[c->nEnr++];
+    memset(e, 0, sizeof(*e));
+    strcpy(e->studentId, f[0]);
+    strcpy(e->courseCode, f[1]);
+    strcpy(e->term, f[2]);
+    strcpy(e->grade, "NA");
+    keyset_add(&c->keys, h);
+    return BULK_ADDED;
+}
+
+/* File index of the enrollment sid/code/term, or -1 */
+long bulk_find_enrollment(const char *sid, const char *code, const char *term, Enrollment *out)
+{
+    EnrAdj *a = g_cfg.enrIndex == ENR_INDEX_ADJACENCY ? adj_ensure() : NULL;
+    if (!a)
+    {
+        EnrKey key;
+        snprintf(key.sid, MAX_ID, "%s", sid);
+        snprintf(key.code, MAX_CODE, "%s", code);
+        snprintf(key.term, MAX_TERM, "%s", term);
+        return file_find_first(FILE_ENR, sizeof(Enrollment), pred_enr_by_key, &key, out);
+    }
+    int32_t n;
+    const int32_t *refs = adj_refs(&a->byStudent, sid, &n);
+    Enrollment *mine = n ? (Enrollment *)malloc((size_t)n * sizeof(Enrollment)) : NULL;
+    long idx = -1;
+    if (mine && enr_read_refs(refs, n, mine) == n) // same order as refs
+        for (int32_t i = 0; i < n && idx < 0; i++)
+            if (strcmp(mine[i].courseCode, code) == 0 && strcmp(mine[i].term, term) == 0)
+            {
+                *out = mine[i];
+                idx = refs[i];
+            }
+    free(mine);
+    return idx;
+}
+
+int bulk_row_grade(BulkCtx *c, char **f, char *key)
+{
+    char g[3];
+    snprintf(g, sizeof(g), "%.2s", f[3]);
+    upper(g);
+    if (strlen(f[3]) > 2 || (grade_to_points(g) < 0 && strcmp(g, "NA") != 0))
+        return bulk_bad(c, "invalid grade");
+    snprintf(key, BULK_KEY, "%.*s|%.*s|%.*s", MAX_ID - 1, f[0], MAX_CODE - 1, f[1], MAX_TERM - 1, f[2]);
+    Enrollment e;
+    long idx = bulk_find_enrollment(f[0], f[1], f[2], &e);
+    if (idx < 0)
+        return bulk_bad(c, "enrollment not found");
+    if (strcmp(e.grade, g) == 0)
+        return BULK_SKIPPED;
+    strcpy(e.grade, g);
+    if (!file_write_at(FILE_ENR, sizeof(Enrollment), idx, &e))
+        return bulk_bad(c, "write error");
+    on_grade_changed(&e);
+    return BULK_ADDED;
+}
+
+/* The Learner program only appends: a correction is a later line with the
+ * same roll, a delete is a "#DEL,roll" line.  Find the line that holds the
+ * current version of every roll, so older versions and deleted rolls are
+ * not migrated.  Options are "dept|batch|id prefix"; the Learner file has
+ * neither dept nor batch, and its cgpa and sex have no Student field. */
+int cmp_learner_last(const void *a, const void *b)
+{
+    const LearnerLast *x = (const LearnerLast *)a, *y = (const LearnerLast *)b;
+    if (x->roll != y->roll)
+        return x->roll < y->roll ? -1 : 1;
+    return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+int cmp_learner_last_roll(const void *a, const void *b)
+{
+    int32_t x = ((const LearnerLast *)a)->roll, y = ((const LearnerLast *)b)->roll;
+    return (x > y) - (x < y);
+}
+
+int bulk_prepare_learners(BulkCtx *c)
+{
+    char opts[64];
+    snprintf(opts, sizeof(opts), "%s", c->opts ? c->opts : "");
+    char *batch = strchr(opts, '|'), *prefix = batch ? strchr(batch + 1, '|') : NULL;
+    if (batch)
+        *batch++ = 0;
+    if (prefix)
+        *prefix++ = 0;
+    int b;
+    if (!opts[0] || strlen(opts) >= MAX_DEPT || !batch || !parse_int(batch, &b) || b <= 0 ||
+        (prefix && strlen(prefix) >= sizeof(c->prefix) - 2))
+    {
+        printf("Options must be dept|batch|id prefix (prefix up to 5 characters, may be empty).\n");
+        return 0;
+    }
+    snprintf(c->dept, sizeof(c->dept), "%s", opts);
+    snprintf(c->batch, sizeof(c->batch), "%d", b);
+    snprintf(c->prefix, sizeof(c->prefix), "%s", prefix ? prefix : "");
+    if (!bulk_prepare_students(c))
+        return 0;
+
+    FILE *in = fopen(c->input, "rb");
+    if (!in)
+        return 0;
+    char line[BULK_LINE];
+    long cap = 0, n = 0;
+    int32_t lineNo = 0, roll;
+    while (fgets(line, sizeof(line), in))
+    {
+        lineNo++; // counted exactly like bulk_run counts them
+        size_t len = strlen(line);
+        if (len + 1 == sizeof(line) && line[len - 1] != '\n')
+        {
+            int ch;
+            while ((ch = fgetc(in)) != '\n' && ch != EOF)
+                ;
+            continue;
+        }
+        int del = sscanf(line, "#DEL,%d", &roll) == 1;
+        if (!del && (line[0] == '#' || sscanf(line, "%d,", &roll) != 1))
+            continue;
+        if (n == cap)
+        {
+            cap = cap ? cap * 2 : 1024;
+            LearnerLast *nl = (LearnerLast *)realloc(c->last, (size_t)cap * sizeof(LearnerLast));
+            if (!nl)
+            {
+                fclose(in);
+                return 0;
+            }
+            c->last = nl;
+        }
+        c->last[n].roll = roll;
+        c->last[n].line = del ? 0 : lineNo;
+        c->last[n].seq = (int32_t)n;
+        n++;
+    }
+    fclose(in);
+    if (n)
+        qsort(c->last, (size_t)n, sizeof(LearnerLast), cmp_learner_last);
+    long kept = 0;
+    for (long i = 0; i < n; i++)
+    {
+        if (kept && c->last[kept - 1].roll == c->last[i].roll)
+            kept--; // a later event of the same roll replaces it
+        c->last[kept++] = c->last[i];
+    }
+    c->nLast = kept;
+    return 1;
+}
+
+int bulk_row_learner(BulkCtx *c, char **f, char *key)
+{
+    int roll;
+    if (!parse_int(f[0], &roll) || roll <= 0)
+        return bulk_bad(c, "bad roll");
+    LearnerLast k = {roll, 0, 0};
+    const LearnerLast *l = (const LearnerLast *)bsearch(&k, c->last, (size_t)c->nLast, sizeof(LearnerLast),
+                                                        cmp_learner_last_roll);
+    if (!l || l->line != c->line)
+        return BULK_SKIPPED; // corrected later in the file, or deleted
+    char id[MAX_ID + 8];
+    snprintf(id, sizeof(id), "%s%d", c->prefix, roll);
+    char *g[5] = {id, f[1], c->dept, c->batch, ""};
+    return bulk_row_student(c, g, key);
+}
+
+static const BulkKind BULK_KINDS[] = {
+    {"students", "id,name,dept,batch,email", 5, bulk_prepare_students, bulk_row_student, NULL},
+    {"enrollments", "sid,code,term", 3, bulk_prepare_enrollments, bulk_row_enrollment, NULL},
+    {"grades", "sid,code,term,grade", 4, bulk_prepare_grades, bulk_row_grade, NULL},
+    {"learners", "roll,fullname,cgpa,sex", 4, bulk_prepare_learners, bulk_row_learner, "dept|batch|id prefix"},
+};
+#define BULK_KIND_COUNT (int)(sizeof(BULK_KINDS) / sizeof(BULK_KINDS[0]))
+
+/* Write the pending appends of this batch; 0 on failure (nothing kept) */
+int bulk_commit(BulkCtx *c)
+{
+    long ref = file_count_records(FILE_ENR, sizeof(Enrollment));
+    if (c->nStu && !file_append_batch(FILE_STUD, sizeof(Student), c->stu, (size_t)c->nStu))
+        return 0;
+    if (c->nEnr && !file_append_batch(FILE_ENR, sizeof(Enrollment), c->enr, (size_t)c->nEnr))
+        return 0;
+    for (int i = 0; i < c->nStu; i++)
+        on_student_changed(&c->stu[i]);
+    for (int i = 0; i < c->nEnr; i++)
+        on_enrollment_appended(&c->enr[i], ref + i);
+    c->nStu = c->nEnr = 0;
+    return 1;
+}
+
+int bulk_save_checkpoint(const BulkCheckpoint *ck)
+{
+    char tmp[MAX_PATH_LEN + 4];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", FILE_BULK_CKPT);
+    OPEN_BIN_WRITE(tmp, fp);
+    if (!fp)
+        return 0;
+    int ok = fwrite(ck, sizeof(*ck), 1, fp) == 1 && fflush(fp) == 0 && FSYNC(fp) == 0;
+    if (fclose(fp) != 0)
+        ok = 0;
+    return ok && rename(tmp, FILE_BULK_CKPT) == 0;
+}
+
+/* Split one input line (newline stripped) and hand it to the kind's row
+ * function: BULK_*, or -1 for blank and comment lines */
+int bulk_line(BulkCtx *c, char *line, char *key)
+{
+    char *f[8] = {0};
+    int nf = 0;
+    for (char *p = line; p && nf < 8;)
+    {
+        f[nf++] = p;
+        p = strchr(p, ',');
+        if (p)
+            *p++ = 0;
+    }
+    if (!line[0] || line[0] == '#')
+        return -1;
+    if (nf != c->kind->fields)
+    {
+        snprintf(c->why, sizeof(c->why), "expected %d fields (%s)", c->kind->fields, c->kind->format);
+        return BULK_BAD;
+    }
+    for (int i = 0; i < nf; i++)
+        f[i] = trim(f[i]);
+    return c->kind->row(c, f, key);
+}
+
+/* Run one bulk operation; resume says whether an existing checkpoint for
+ * the same input may be used.  Returns 1 when the whole file was done. */
+int bulk_run(const BulkKind *kind, const char *path, const char *opts, int resume)
+{
+    trace_args("kind=%s input=%s", kind->name, path);
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        printf("Cannot open %s\n", path);
+        return 0;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    BulkCheckpoint ck;
+    memset(&ck, 0, sizeof(ck));
+    OPEN_BIN_READ(FILE_BULK_CKPT, cf);
+    int have = cf && fread(&ck, sizeof(ck), 1, cf) == 1 && ck.magic == BULK_MAGIC &&
+               strcmp(ck.kind, kind->name) == 0 && strcmp(ck.input, path) == 0 && ck.inputSize == size &&
+               ck.offset <= size;
+    if (cf)
+        fclose(cf);
+    if (have && resume)
+    {
+        printf("Resuming at line %lld (last committed key %s).\n", (long long)ck.line + 1,
+               ck.lastKey[0] ? ck.lastKey : "-");
+        if (ck.opts[0] && strcmp(ck.opts, opts) != 0)
+            printf("Keeping the options of the first run: %s\n", ck.opts);
+    }
     else
-        printf("Error writing student file.\n");
+    {
+        memset(&ck, 0, sizeof(ck));
+        ck.magic = BULK_MAGIC;
+        snprintf(ck.kind, sizeof(ck.kind), "%s", kind->name);
+        snprintf(ck.input, sizeof(ck.input), "%s", path);
+        ck.inputSize = size;
+        snprintf(ck.opts, sizeof(ck.opts), "%s", opts);
+    }
+    fseek(in, (long)ck.offset, SEEK_SET);
+
+    BulkCtx c;
+    memset(&c, 0, sizeof(c));
+    c.kind = kind;
+    c.input = path;
+    c.opts = ck.opts;
+    int batchMax = (int)g_cfg.bulkBatch;
+    c.stu = (Student *)malloc((size_t)batchMax * sizeof(Student));
+    c.enr = (Enrollment *)malloc((size_t)batchMax * sizeof(Enrollment));
+    int ok = c.stu && c.enr && kind->prepare(&c);
+    char line[BULK_LINE], key[BULK_KEY] = "", lastKey[BULK_KEY] = "";
+    int inBatch = 0, shownBad = 0;
+    double t0 = now_us();
+    while (ok)
+    {
+        int eof = !fgets(line, sizeof(line), in);
+        if (!eof)
+        {
+            ck.line++;
+            size_t len = strlen(line);
+            if (len + 1 == sizeof(line) && line[len - 1] != '\n')
+            {
+                int ch;
+                while ((ch = fgetc(in)) != '\n' && ch != EOF)
+                    ; // rest of an overlong line
+                ck.bad++;
+                if (shownBad++ < 10)
+                    printf("  line %lld: too long\n", (long long)ck.line);
+                continue;
+            }
+            line[strcspn(line, "\r\n")] = 0;
+            c.line = (long)ck.line;
+            int r = bulk_line(&c, line, key);
+            if (r < 0)
+                continue;
+            if (r == BULK_ADDED)
+            {
+                ck.added++;
+                snprintf(lastKey, sizeof(lastKey), "%s", key);
+            }
+            else if (r == BULK_SKIPPED)
+                ck.skipped++;
+            else
+            {
+                ck.bad++;
+                if (shownBad++ < 10)
+                    printf("  line %lld: %s\n", (long long)ck.line, c.why);
+            }
+            inBatch++;
+        }
+        if (inBatch && (eof || inBatch >= batchMax || c.nStu >= batchMax || c.nEnr >= batchMax))
+        {
+            if (!bulk_commit(&c))
+            {
+                printf("Write error; stopped at the last checkpoint (line %lld).\n", (long long)ck.line);
+                ok = 0;
+                break;
+            }
+            ck.offset = ftell(in);
+            snprintf(ck.lastKey, sizeof(ck.lastKey), "%s", lastKey);
+            if (!bulk_save_checkpoint(&ck))
+                printf("[bulk] could not save checkpoint; a rerun will skip committed rows by key\n");
+            inBatch = 0;
+        }
+        if (eof)
+            break;
+    }
+    fclose(in);
+    free(c.stu);
+    free(c.enr);
+    free(c.sids);
+    free(c.cs);
+    free(c.last);
+    keyset_free(&c.keys);
+    if (ok)
+        remove(FILE_BULK_CKPT); // finished: nothing to resume
+    printf("%s %s: %lld added, %lld already present, %lld rejected (%.2f s)\n", ok ? "Imported" : "Stopped",
+           kind->name, (long long)ck.added, (long long)ck.skipped, (long long)ck.bad, (now_us() - t0) / 1e6);
+    return ok;
+}
+
+void bulk_import()
+{
+    printf("Kinds:");
+    for (int i = 0; i < BULK_KIND_COUNT; i++)
+        printf(" %d) %s [%s]", i + 1, BULK_KINDS[i].name, BULK_KINDS[i].format);
+    printf("\n");
+    int k = read_int("Kind: ");
+    if (k < 1 || k > BULK_KIND_COUNT)
+    {
+        printf("Invalid.\n");
+        return;
+    }
+    char path[MAX_PATH_LEN], yn[8] = "y", opts[64] = "", prompt[96];
+    read_line("CSV file: ", path, sizeof(path));
+    if (!path[0])
+        return;
+    if (BULK_KINDS[k - 1].options)
+    {
+        snprintf(prompt, sizeof(prompt), "Options (%s): ", BULK_KINDS[k - 1].options);
+        read_line(prompt, opts, sizeof(opts));
+    }
+    BulkCheckpoint ck;
+    OPEN_BIN_READ(FILE_BULK_CKPT, cf);
+    if (cf && fread(&ck, sizeof(ck), 1, cf) == 1 && ck.magic == BULK_MAGIC)
+    {
+        printf("Unfinished %s import of %s stopped at line %lld.\n", ck.kind, ck.input, (long long)ck.line);
+        read_line("Resume it if it is this file? (y/n): ", yn, sizeof(yn));
+    }
+    if (cf)
+        fclose(cf);
+    bulk_run(&BULK_KINDS[k - 1], path, opts, yn[0] == 'y' || yn[0] == 'Y');
+}
+
+/* ======== TRANSCRIPT DATA ======== */
+typedef struct
+{
+    char code[MAX_CODE];
+    char title[MAX_TITLE];
+    char term[MAX_TERM];
+    char grade[3];
+    int32_t credX100;
+    int32_t ptsX100; // -1 when ungraded
+} TranscriptRow;
+
+typedef struct
+{
+    Student stu; // id always set; other fields blank if profile is missing
+    TranscriptRow *rows;
+    int n;
+    int hasProfile;   // stu came from students.dat
+    int64_t credX100; // graded credits
+    int64_t qp;       // sum of ptsX100 * credX100
+} Transcript;
+
+int cmp_course_code(const void *a, const void *b)
+{
+    return strcmp(((const Course *)a)->code, ((const Course *)b)->code);
+}
+
+/* Whole course table sorted by code, for bsearch lookups */
+Course *courses_load_sorted(long *n)
+{
+    Course *cs = (Course *)file_load_all(FILE_COURSE, sizeof(Course), n);
+    if (cs)
+        qsort(cs, (size_t)*n, sizeof(Course), cmp_course_code);
+    return cs;
+}
+
+const Course *course_lookup(const Course *cs, long n, const char *code)
+{
+    Course key;
+    strncpy(key.code, code, MAX_CODE - 1);
+    key.code[MAX_CODE - 1] = 0;
+    return (const Course *)bsearch(&key, cs, (size_t)n, sizeof(Course), cmp_course_code);
+}
+
+#define STUDENT_SCAN_BLOCK 256 // students.dat records per read
+
+typedef struct
+{
+    char sid[MAX_ID]; // first, for cmp_sid
+    long at;          // position in the caller's list
+} SidRef;
+
+/* Look up n student IDs with one pass over students.dat: the IDs are
+ * sorted (as export_transcripts sorts enrollments), the file is streamed
+ * in blocks and each student is binary-searched among them, so a 200-row
+ * roster neither loads nor sorts the whole table.  out[i] is the first
+ * student with ids[i], or NULL; the returned array holds them and is the
+ * caller's to free. */
+Student *students_match(const char *const *ids, long n, const Student **out)
+{
+    for (long i = 0; i < n; i++)
+        out[i] = NULL;
+    OPEN_BIN_READ(FILE_STUD, fp);
+    if (!fp || !n)
+    {
+        if (fp)
+            fclose(fp);
+        return NULL;
+    }
+    trace_begin("storage", "students_match", "%ld ids", n);
+    SidRef *refs = (SidRef *)malloc((size_t)n * sizeof(SidRef));
+    Student *found = (Student *)malloc((size_t)n * sizeof(Student));
+    Student *blk = (Student *)malloc(STUDENT_SCAN_BLOCK * sizeof(Student));
+    long scanned = 0;
+    if (refs && found && blk)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            snprintf(refs[i].sid, MAX_ID, "%s", ids[i]);
+            refs[i].at = i;
+        }
+        qsort(refs, (size_t)n, sizeof(SidRef), cmp_sid);
+        size_t got;
+        while ((got = fread(blk, sizeof(Student), STUDENT_SCAN_BLOCK, fp)) > 0)
+            for (size_t j = 0; j < got; j++, scanned++)
+            {
+                long lo = 0, hi = n;
+                while (lo < hi) // first ref of this student
+                {
+                    long mid = lo + (hi - lo) / 2;
+                    if (strcmp(refs[mid].sid, blk[j].id) < 0)
+                        lo = mid + 1;
+                    else
+                        hi = mid;
+                }
+                for (; lo < n && strcmp(refs[lo].sid, blk[j].id) == 0; lo++)
+                    if (!out[refs[lo].at])
+                    {
+                        found[refs[lo].at] = blk[j];
+                        out[refs[lo].at] = &found[refs[lo].at];
+                    }
+            }
+    }
+    fclose(fp);
+    free(refs);
+    free(blk);
+    trace_io(scanned, scanned * (long)sizeof(Student));
+    trace_end();
+    if (!found)
+        for (long i = 0; i < n; i++)
+            out[i] = NULL;
+    return found;
+}
+
+/* Join one student's enrollment rows with the course table */
+void transcript_build(Transcript *t, const Student *s, const char *sid,
+                      const Enrollment *enr, long nEnr, const Course *cs, long nc)
+{
+    memset(t, 0, sizeof(*t));
+    t->hasProfile = s != NULL;
+    if (s)
+        t->stu = *s;
+    else
+        strncpy(t->stu.id, sid, MAX_ID - 1);
+    t->rows = (TranscriptRow *)malloc((nEnr ? (size_t)nEnr : 1) * sizeof(TranscriptRow));
+    if (!t->rows)
+        return;
+    GpaColumns cols = {0};
+    for (long i = 0; i < nEnr; i++)
+    {
+        const Enrollment *e = &enr[i];
+        if (strcmp(e->studentId, sid) != 0)
+            continue;
+        const Course *c = course_lookup(cs, nc, e->courseCode);
+        if (!c)
+            continue;
+        TranscriptRow *r = &t->rows[t->n++];
+        strcpy(r->code, c->code);
+        strcpy(r->title, c->title);
+        strcpy(r->term, e->term);
+        strcpy(r->grade, e->grade);
+        r->credX100 = credit_x100(c->credit);
+        r->ptsX100 = grade_to_points_x100(e->grade);
+        gpa_cols_push(&cols, 0, r->credX100, r->ptsX100, 1);
+    }
+    int32_t graded = 0;
+    gpa_kernel(&cols, &t->qp, &t->credX100, &graded);
+    gpa_cols_free(&cols);
+}
+
+/* Returns 0 when there is no enrollment file at all */
+int transcript_load(const char *sid, Transcript *t)
+{
+    if (file_count_records(FILE_ENR, sizeof(Enrollment)) == 0 &&
+        file_count_records(FILE_ARCH_CAT, sizeof(ArchiveEntry)) == 0)
+        return 0;
+    long n, nc;
+    Enrollment *mine = enr_for_key(0, sid, &n);
+    mine = archive_merge_student(mine, &n, sid); // closed terms
+    Course *cs = courses_load_sorted(&nc);
+    Student s;
+    int have = file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, sid, &s) >= 0;
+    transcript_build(t, have ? &s : NULL, sid, mine, n, cs, nc);
+    free(cs);
+    free(mine);
+    return 1;
+}
+
+void transcript_free(Transcript *t)
+{
+    free(t->rows);
+    t->rows = NULL;
+    t->n = 0;
+}
+
+/* Courses, terms, credits, grades and CGPA as plain text */
+void transcript_render_text(const Transcript *t, StrBuf *out)
+{
+    sb_printf(out, "\n-- Transcript for %s --\n", t->stu.id);
+    for (int i = 0; i < t->n; i++)
+    {
+        const TranscriptRow *r = &t->rows[i];
+        sb_printf(out, "%-8s | %-10s | %4.1f cr | Grade: %-2s", r->code, r->term, r->credX100 / 100.0, r->grade);
+        if (r->ptsX100 >= 0)
+            sb_printf(out, " | GP: %.2f", r->ptsX100 / 100.0);
+        sb_puts(out, "\n");
+    }
+    if (t->credX100 > 0)
+    {
+        sb_printf(out, "CGPA: %.2f (%.1f total credits)\n", gpa_x100(t->qp, t->credX100) / 100.0,
+                  t->credX100 / 100.0);
+    }
+    else
+    {
+        sb_puts(out, "No graded credits yet.\n");
+    }
+}
+
+void transcript_report(const char *sid, StrBuf *out, ReportEntry *dep)
+{
+    Transcript t;
+    report_dep(dep, DEP_STUDENT, sid);
+    if (!transcript_load(sid, &t))
+    {
+        sb_puts(out, "No enrollments.\n");
+        return;
+    }
+    for (int i = 0; i < t.n; i++)
+        report_dep(dep, DEP_COURSE, t.rows[i].code);
+    transcript_render_text(&t, out);
+    transcript_free(&t);
+}
+
+void transcript_for_student(const char *sid)
+{
+    trace_args("sid=%s", redact_id(sid));
+    report_show(REPORT_TRANSCRIPT, sid, transcript_report);
+}
+
+void roster_for_course_term(const char *code, const char *term)
+{
+    trace_args("code=%s term=%s", code, term);
+    if (file_count_records(FILE_ENR, sizeof(Enrollment)) == 0 && archive_find(term, NULL) < 0)
+    {
+        printf("No enrollments.\n");
+        return;
+    }
+    long n, na;
+    Enrollment *enr = enr_for_key(1, code, &n);
+    Enrollment *arch = archive_rows(term, NULL, &na); // empty unless the term is archived
+    for (long i = 0; i < na; i++)
+        if (strcmp(arch[i].courseCode, code) == 0)
+        {
+            Enrollment *p = (Enrollment *)realloc(enr, (size_t)(n + 1) * sizeof(Enrollment));
+            if (!p)
+                break;
+            enr = p;
+            enr[n++] = arch[i];
+        }
+    free(arch);
+    long m = 0;
+    for (long i = 0; i < n; i++) // keep the term's rows, in order
+        if (strcmp(enr[i].term, term) == 0)
+            enr[m++] = enr[i];
+    const char **ids = (const char **)malloc((size_t)(m + 1) * sizeof(char *));
+    const Student **who = (const Student **)malloc((size_t)(m + 1) * sizeof(Student *));
+    Student *stu = NULL;
+    if (ids && who)
+    {
+        for (long i = 0; i < m; i++)
+            ids[i] = enr[i].studentId;
+        stu = students_match(ids, m, who);
+    }
+    int count = 0;
+    printf("\n-- Roster %s (%s) --\n", code, term);
+    for (long i = 0; who && ids && i < m; i++)
+        if (who[i])
+        {
+            printf("%-12s  %-24s  Grade: %-2s\n", who[i]->id, who[i]->name, enr[i].grade);
+            count++;
+        }
+    free(stu);
+    free(ids);
+    free(who);
+    free(enr);
+    if (!count)
+        printf("No students enrolled.\n");
+}
+
+typedef struct
+{
+    int32_t group;    // student number in the adjacency key table
+    int64_t qp;       // quality points, see FIXED-POINT GRADES
+    int64_t credX100;
+} LeaderRow;
+
+int cmp_leader_desc(const void *a, const void *b)
+{
+    const LeaderRow *x = (const LeaderRow *)a, *y = (const LeaderRow *)b;
+    int c = gpa_cmp(y->qp, y->credX100, x->qp, x->credX100);
+    return c ? c : (x->group > y->group) - (x->group < y->group);
+}
+
+void leaderboard_report(const char *term, StrBuf *out, ReportEntry *dep)
+{
+    // term rows -> columns -> GPA kernel, grouped by student number
+    report_dep(dep, DEP_TERM, term);
+    EnrAdj *a = adj_ensure();
+    if (!a)
+    {
+        sb_puts(out, "No enrollments.\n");
+        return;
+    }
+    long nc, nl;
+    Course *cs = courses_load_sorted(&nc);
+    GpaColumns cols = {0};
+    Enrollment *live = enr_scan(term, NULL, NULL, &nl); // zone maps skip other terms' blocks
+    for (long i = 0; i < nl; i++)
+    {
+        const Enrollment *e = &live[i];
+        const Course *c = course_lookup(cs, nc, e->courseCode);
+        report_dep(dep, DEP_COURSE, e->courseCode);
+        int32_t g = adj_find(&a->byStudent, e->studentId);
+        gpa_cols_push(&cols, g < 0 ? 0 : g, c ? credit_x100(c->credit) : 0, grade_to_points_x100(e->grade),
+                      c && g >= 0);
+    }
+    free(live);
+
+    // an archived term: its rows come sorted by student from the segment;
+    // students with no live enrollment get groups after the adjacency's
+    int32_t ng = a->byStudent.nkeys, extra = 0;
+    long na;
+    Enrollment *arch = archive_rows(term, NULL, &na);
+    char(*extraIds)[MAX_ID] = na ? malloc((size_t)na * MAX_ID) : NULL;
+    for (long i = 0; i < na; i++)
+    {
+        const Enrollment *r = &arch[i];
+        const Course *c = course_lookup(cs, nc, r->courseCode);
+        report_dep(dep, DEP_COURSE, r->courseCode);
+        int32_t g = adj_find(&a->byStudent, r->studentId);
+        if (g < 0 && extraIds)
+        {
+            if (!extra || strcmp(extraIds[extra - 1], r->studentId) != 0)
+                memcpy(extraIds[extra++], r->studentId, MAX_ID);
+            g = ng + extra - 1;
+        }
+        gpa_cols_push(&cols, g < 0 ? 0 : g, c ? credit_x100(c->credit) : 0, grade_to_points_x100(r->grade),
+                      c && g >= 0);
+    }
+    free(arch);
+    free(cs);
+
+    int32_t groups = ng + extra;
+    int64_t *qp = (int64_t *)calloc((size_t)groups + 1, sizeof(int64_t));
+    int64_t *cred = (int64_t *)calloc((size_t)groups + 1, sizeof(int64_t));
+    int32_t *graded = (int32_t *)calloc((size_t)groups + 1, sizeof(int32_t));
+    LeaderRow *rows = (LeaderRow *)malloc(((size_t)groups + 1) * sizeof(LeaderRow));
+    int n = 0;
+    if (qp && cred && graded && rows)
+    {
+        gpa_kernel(&cols, qp, cred, graded);
+        for (int32_t g = 0; g < groups; g++)
+            if (graded[g])
+            {
+                rows[n].group = g;
+                rows[n].qp = qp[g];
+                rows[n].credX100 = cred[g];
+                n++;
+            }
+        qsort(rows, (size_t)n, sizeof(LeaderRow), cmp_leader_desc);
+    }
+    gpa_cols_free(&cols);
+    free(qp);
+    free(cred);
+    free(graded);
+
+    sb_printf(out, "\n-- Term GPA Leaderboard: %s --\n", term);
+    int shown = n < g_cfg.leaderboardMax ? n : (int)g_cfg.leaderboardMax;
+    const char **ids = (const char **)calloc((size_t)shown + 1, sizeof(char *));
+    const Student **who = (const Student **)calloc((size_t)shown + 1, sizeof(Student *));
+    Student *stu = NULL;
+    for (int i = 0; ids && i < shown; i++)
+        ids[i] = rows[i].group < ng ? a->byStudent.keys[rows[i].group] : extraIds[rows[i].group - ng];
+    if (ids && who)
+        stu = students_match(ids, shown, who);
+    for (int i = 0; i < shown; i++)
+    {
+        const char *sid = rows[i].group < ng ? a->byStudent.keys[rows[i].group] : extraIds[rows[i].group - ng];
+        double gpa = gpa_x100(rows[i].qp, rows[i].credX100) / 100.0;
+        double cr = rows[i].credX100 / 100.0;
+        const Student *s = who ? who[i] : NULL;
+        report_dep(dep, DEP_STUDENT, sid);
+        if (s)
+        {
+            sb_printf(out, "%2d) %-12s %-24s GPA: %.2f (%.1f cr)\n", i + 1, s->id, s->name, gpa, cr);
+        }
+        else
+        {
+            sb_printf(out, "%2d) %-12s GPA: %.2f (%.1f cr)\n", i + 1, sid, gpa, cr);
+        }
+    }
+    if (shown < n)
+        sb_printf(out, "(top %d of %d students shown: leaderboard_max)\n", shown, n);
+    free(stu);
+    free(ids);
+    free(who);
+    free(rows);
+    free(extraIds);
+}
+
+void gpa_leaderboard(const char *term)
+{
+    trace_args("term=%s", term);
+    report_show(REPORT_LEADERBOARD, term, leaderboard_report);
 }
 
-void edit_student()
+/* ======== STUDENT SNAPSHOTS ========
+ * The student menu (profile, transcript) is the busiest read path, so each
+ * student gets a denormalized snapshot: profile, enrollment rows with
+ * course titles and credits, and the GPA totals, in one small file under
+ * snapshots/.  A view is then one file read instead of a students.dat
+ * scan plus a transcript build.  Snapshots are never patched in place.
+ * When a student's data changes (see the change hooks), the file is
+ * removed at once and the student is queued.  The queue is worked off at
+ * idle points (menu loop tops, idle server), so the snapshot is rebuilt
+ * before the next view in the common case and on demand otherwise.
+ * Students without a snapshot are not queued: a bulk import touching
+ * thousands of never-viewed students would otherwise build them all.
+ */
+#define SNAP_MAGIC 0x504E5355u // "USNP"
+#define SNAP_VERSION 1
+#define SNAP_FLUSH_BATCH 32 // rebuilds per idle point
+
+typedef struct
 {
-    char id[MAX_ID];
-    read_line("Enter Student ID to edit: ", id, sizeof(id));
-    Student s;
-    long idx = file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, id, &s);
-    if (idx < 0)
+    uint32_t magic, version;
+    int32_t hasProfile, n;
+    int64_t credX100, qp;
+    Student stu;
+} SnapHeader;
+
+static char (*g_snapDirty)[MAX_ID]; // queued student IDs (active campus)
+static int g_snapDirtyN, g_snapDirtyCap;
+static long g_snapHits, g_snapBuilds;
+
+/* One file per ID: "A/1" and "A_1" must not share a snapshot */
+void snapshot_path(const char *sid, char *out, size_t cap)
+{
+    char name[MAX_ID + 18];
+    unique_filename(sid, name, sizeof(name));
+    snprintf(out, cap, "%s/%s.snap", FILE_SNAP, name);
+}
+
+/* Build the transcript and write it out (temp file + rename) */
+int snapshot_build(const char *sid, Transcript *t)
+{
+    trace_begin("snapshot", "snapshot_build", "%s", redact_id(sid));
+    int ok = transcript_load(sid, t);
+    if (ok)
     {
-        printf("Not found.\n");
-        return;
+        char path[MAX_PATH_LEN + 48], tmp[MAX_PATH_LEN + 52];
+        snapshot_path(sid, path, sizeof(path));
+        snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+        SnapHeader h;
+        memset(&h, 0, sizeof(h));
+        h.magic = SNAP_MAGIC;
+        h.version = SNAP_VERSION;
+        h.hasProfile = t->hasProfile;
+        h.n = t->n;
+        h.credX100 = t->credX100;
+        h.qp = t->qp;
+        h.stu = t->stu;
+        MKDIR(FILE_SNAP);
+        OPEN_BIN_WRITE(tmp, fp);
+        int wrote = fp && fwrite(&h, sizeof(h), 1, fp) == 1 &&
+                    fwrite(t->rows, sizeof(TranscriptRow), (size_t)t->n, fp) == (size_t)t->n;
+        if (fp && fclose(fp) != 0)
+            wrote = 0;
+        if (wrote)
+            wrote = rename(tmp, path) == 0;
+        if (!wrote)
+            remove(tmp); // still served, just not saved
+        trace_io(wrote, wrote ? (long)(sizeof(h) + (size_t)t->n * sizeof(TranscriptRow)) : 0);
+        g_snapBuilds++;
     }
-    print_student(&s);
-    printf("Leave blank to keep existing.\n");
-    char buf[128];
-    read_line("New name: ", buf, sizeof(buf));
-    if (strlen(buf))
-        strncpy(s.name, buf, MAX_NAME);
-    read_line("New dept: ", buf, sizeof(buf));
-    if (strlen(buf))
-        strncpy(s.dept, buf, MAX_DEPT);
-    read_line("New email: ", buf, sizeof(buf));
-    if (strlen(buf))
-        strncpy(s.email, buf, MAX_EMAIL);
-    buf[0] = 0;
-    read_line("New batch (empty to keep): ", buf, sizeof(buf));
-    if (strlen(buf))
-        s.batch = atoi(buf);
-    if (file_write_at(FILE_STUD, sizeof(Student), idx, &s))
-        printf("Updated.\n");
-    else
-        printf("Write error.\n");
+    trace_end();
+    return ok;
 }
 
-void list_students()
+int snapshot_read(const char *sid, Transcript *t)
 {
-    OPEN_BIN_READ(FILE_STUD, fp);
+    char path[MAX_PATH_LEN + 48];
+    snapshot_path(sid, path, sizeof(path));
+    OPEN_BIN_READ(path, fp);
     if (!fp)
+        return 0;
+    SnapHeader h;
+    memset(t, 0, sizeof(*t));
+    int ok = fread(&h, sizeof(h), 1, fp) == 1 && h.magic == SNAP_MAGIC && h.version == SNAP_VERSION &&
+             h.n >= 0 && h.n <= 1000000 && strcmp(h.stu.id, sid) == 0;
+    if (ok)
     {
-        printf("No students yet.\n");
-        return;
+        t->rows = (TranscriptRow *)malloc((h.n ? (size_t)h.n : 1) * sizeof(TranscriptRow));
+        ok = t->rows && fread(t->rows, sizeof(TranscriptRow), (size_t)h.n, fp) == (size_t)h.n;
     }
-    Student s;
-    printf("\n-- Students --\n");
-    while (fread(&s, sizeof(Student), 1, fp) == 1)
-        print_student(&s);
     fclose(fp);
+    if (!ok)
+    {
+        transcript_free(t);
+        return 0;
+    }
+    t->stu = h.stu;
+    t->hasProfile = h.hasProfile;
+    t->n = h.n;
+    t->credX100 = h.credX100;
+    t->qp = h.qp;
+    trace_io(1, (long)(sizeof(h) + (size_t)h.n * sizeof(TranscriptRow)));
+    return 1;
 }
 
-void add_faculty()
+/* Remove sid from the queue; 1 if it was there */
+int snapshot_unqueue(const char *sid)
 {
-    Faculty f = {0};
-    read_line("Faculty ID: ", f.id, sizeof(f.id));
-    if (file_find_first(FILE_FAC, sizeof(Faculty), pred_faculty_by_id, f.id, NULL) >= 0)
+    for (int i = 0; i < g_snapDirtyN; i++)
+        if (strcmp(g_snapDirty[i], sid) == 0)
+        {
+            memmove(g_snapDirty[i], g_snapDirty[i + 1], (size_t)(g_snapDirtyN - i - 1) * MAX_ID);
+            g_snapDirtyN--;
+            return 1;
+        }
+    return 0;
+}
+
+void snapshot_mark(const char *sid)
+{
+    char path[MAX_PATH_LEN + 48];
+    snapshot_path(sid, path, sizeof(path));
+    // removed even with snapshots off, or turning them back on would serve it
+    if (remove(path) != 0 || !g_cfg.studentSnapshots)
+        return; // no snapshot yet: built on first view, nothing to refresh
+    for (int i = 0; i < g_snapDirtyN; i++)
+        if (strcmp(g_snapDirty[i], sid) == 0)
+            return;
+    if (g_snapDirtyN == g_snapDirtyCap)
     {
-        printf("Faculty exists.\n");
-        return;
+        int cap = g_snapDirtyCap ? g_snapDirtyCap * 2 : 64;
+        char(*nd)[MAX_ID] = realloc(g_snapDirty, (size_t)cap * MAX_ID);
+        if (!nd)
+            return; // rebuilt on demand instead
+        g_snapDirty = nd;
+        g_snapDirtyCap = cap;
     }
-    read_line("Name: ", f.name, sizeof(f.name));
-    read_line("Dept: ", f.dept, sizeof(f.dept));
-    read_line("Email: ", f.email, sizeof(f.email));
-    if (file_append(FILE_FAC, sizeof(Faculty), &f))
-        printf("Faculty added.\n");
+    snprintf(g_snapDirty[g_snapDirtyN++], MAX_ID, "%s", sid);
+}
+
+/* A course edit changes the rows of everyone who took it */
+void snapshot_mark_course(const char *code)
+{
+    long n;
+    Enrollment *enr = enr_for_key(1, code, &n);
+    for (long i = 0; i < n; i++)
+        snapshot_mark(enr[i].studentId);
+    free(enr);
+}
+
+/* Rebuild up to budget queued snapshots (budget < 0: all of them) */
+void snapshot_flush(int budget)
+{
+    while (g_snapDirtyN > 0 && budget != 0)
+    {
+        char sid[MAX_ID];
+        memcpy(sid, g_snapDirty[g_snapDirtyN - 1], MAX_ID);
+        g_snapDirtyN--;
+        Transcript t;
+        if (snapshot_build(sid, &t))
+            transcript_free(&t);
+        if (budget > 0)
+            budget--;
+    }
+}
+
+/* The student read path: snapshot if current, otherwise build it now */
+int snapshot_get(const char *sid, Transcript *t)
+{
+    if (!g_cfg.studentSnapshots)
+        return transcript_load(sid, t);
+    if (!snapshot_unqueue(sid) && snapshot_read(sid, t))
+    {
+        g_snapHits++;
+        return 1;
+    }
+    return snapshot_build(sid, t);
+}
+
+void student_view_profile(const char *sid)
+{
+    trace_args("sid=%s", redact_id(sid));
+    Transcript t = {0};
+    if (snapshot_get(sid, &t) && t.hasProfile)
+        print_student(&t.stu);
+    else if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, sid, &t.stu) >= 0)
+        print_student(&t.stu); // no enrollment file yet, so no snapshot
     else
-        printf("Write error.\n");
+        printf("Profile not found.\n");
+    transcript_free(&t);
 }
 
-void list_faculty()
+void student_view_transcript(const char *sid)
 {
-    OPEN_BIN_READ(FILE_FAC, fp);
-    if (!fp)
+    trace_args("sid=%s", redact_id(sid));
+    Transcript t;
+    if (!snapshot_get(sid, &t))
     {
-        printf("No faculty yet.\n");
+        printf("No enrollments.\n");
         return;
     }
-    Faculty f;
-    printf("\n-- Faculty --\n");
-    while (fread(&f, sizeof(Faculty), 1, fp) == 1)
-        print_faculty(&f);
+    StrBuf out = {0};
+    transcript_render_text(&t, &out);
+    if (out.p)
+        fputs(out.p, stdout);
+    sb_free(&out);
+    transcript_free(&t);
+}
+
+/* ======== TRANSCRIPT RENDERING ========
+ * Templates use {{var}} placeholders and one {{#rows}}...{{/rows}} loop.
+ * Each template is parsed once into segments and cached for the process;
+ * a file named transcript_html.tpl / transcript_pdf.tpl in the working
+ * folder overrides the built-in one.
+ */
+typedef enum
+{
+    TV_STUDENT_ID,
+    TV_NAME,
+    TV_DEPT,
+    TV_BATCH,
+    TV_EMAIL,
+    TV_CGPA,
+    TV_TOTAL_CREDITS,
+    TV_GENERATED,
+    TV_CODE, // row variables from here on
+    TV_TITLE,
+    TV_TERM,
+    TV_CREDIT,
+    TV_GRADE,
+    TV_GP,
+    TV_COUNT
+} TplVar;
+
+static const char *TPL_VAR_NAMES[TV_COUNT] = {
+    "student_id", "name", "dept", "batch", "email", "cgpa", "total_credits", "generated",
+    "code", "title", "term", "credit", "grade", "gp"};
+
+typedef enum
+{
+    SEG_TEXT,
+    SEG_VAR,
+    SEG_ROWS_BEGIN,
+    SEG_ROWS_END
+} SegKind;
+
+typedef struct
+{
+    SegKind kind;
+    int var;
+    const char *text; // points into Template.src
+    size_t len;
+} TplSeg;
+
+typedef struct
+{
+    char *src;
+    TplSeg *segs;
+    int n;
+    int loaded;
+} Template;
+
+static const char *TPL_HTML_DEFAULT =
+    "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Transcript {{student_id}}</title>\n"
+    "<style>body{font-family:sans-serif}table{border-collapse:collapse}"
+    "td,th{border:1px solid #999;padding:4px 8px}</style></head><body>\n"
+    "<h2>United International University</h2>\n<h3>Official Transcript</h3>\n"
+    "<p>ID: {{student_id}}<br>Name: {{name}}<br>Dept: {{dept}} | Batch: {{batch}}<br>Email: {{email}}</p>\n"
+    "<table><tr><th>Course</th><th>Title</th><th>Term</th><th>Credit</th><th>Grade</th><th>GP</th></tr>\n"
+    "{{#rows}}<tr><td>{{code}}</td><td>{{title}}</td><td>{{term}}</td><td>{{credit}}</td>"
+    "<td>{{grade}}</td><td>{{gp}}</td></tr>\n{{/rows}}</table>\n"
+    "<p>CGPA: {{cgpa}} ({{total_credits}} total credits)</p>\n"
+    "<p><small>Generated {{generated}}</small></p>\n</body></html>\n";
+
+static const char *TPL_PDF_DEFAULT =
+    "United International University\n"
+    "Official Transcript\n\n"
+    "ID    : {{student_id}}\nName  : {{name}}\nDept  : {{dept}}   Batch: {{batch}}\n\n"
+    "Course     Term         Credit  Grade  GP\n"
+    "---------------------------------------------\n"
+    "{{#rows}}{{code}}  {{term}}  {{credit}}  {{grade}}  {{gp}}  {{title}}\n{{/rows}}"
+    "---------------------------------------------\n"
+    "CGPA: {{cgpa}} ({{total_credits}} total credits)\n\n"
+    "Generated {{generated}}\n";
+
+static Template g_tpl_html, g_tpl_pdf;
+
+char *read_text_file(const char *path)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return NULL;
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    rewind(fp);
+    char *s = (n >= 0) ? (char *)malloc((size_t)n + 1) : NULL;
+    if (s)
+        s[fread(s, 1, (size_t)n, fp)] = 0;
     fclose(fp);
+    return s;
 }
 
-void add_course()
+int tpl_parse(Template *t, char *src)
 {
-    Course c = {0};
-    read_line("Course code (e.g., EEE-2101): ", c.code, sizeof(c.code));
-    if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, c.code, NULL) >= 0)
+    int cap = 32;
+    t->src = src;
+    t->n = 0;
+    t->segs = (TplSeg *)malloc((size_t)cap * sizeof(TplSeg));
+    int ok = t->segs != NULL;
+    const char *p = src;
+    while (ok && *p)
     {
-        printf("Course exists.\n");
+        if (t->n + 2 > cap)
+        {
+            cap *= 2;
+            TplSeg *ns = (TplSeg *)realloc(t->segs, (size_t)cap * sizeof(TplSeg));
+            if (!(ok = ns != NULL))
+                break;
+            t->segs = ns;
+        }
+        const char *open = strstr(p, "{{");
+        const char *close = open ? strstr(open + 2, "}}") : NULL;
+        if (!open || !close)
+            open = p + strlen(p);
+        if (open > p)
+        {
+            TplSeg *s = &t->segs[t->n++];
+            s->kind = SEG_TEXT;
+            s->text = p;
+            s->len = (size_t)(open - p);
+        }
+        if (!*open)
+            break;
+        const char *name = open + 2;
+        size_t len = (size_t)(close - name);
+        TplSeg *s = &t->segs[t->n];
+        s->text = open;
+        s->len = (size_t)(close + 2 - open);
+        if (len == 5 && strncmp(name, "#rows", 5) == 0)
+            s->kind = SEG_ROWS_BEGIN;
+        else if (len == 5 && strncmp(name, "/rows", 5) == 0)
+            s->kind = SEG_ROWS_END;
+        else
+        {
+            s->kind = SEG_TEXT; // unknown names are kept verbatim
+            for (int v = 0; v < TV_COUNT; v++)
+                if (strlen(TPL_VAR_NAMES[v]) == len && strncmp(name, TPL_VAR_NAMES[v], len) == 0)
+                {
+                    s->kind = SEG_VAR;
+                    s->var = v;
+                }
+        }
+        t->n++;
+        p = close + 2;
+    }
+    if (!ok)
+    {
+        free(t->segs); // out of memory: the template owns src, so drop both
+        free(src);
+        memset(t, 0, sizeof(*t));
+        return 0;
+    }
+    t->loaded = 1;
+    return 1;
+}
+
+/* Parse on first use, then reuse the cached segments */
+const Template *tpl_get(Template *t, const char *overridePath, const char *builtin)
+{
+    if (!t->loaded)
+    {
+        char *src = read_text_file(overridePath);
+        if (!src)
+            src = strdup(builtin);
+        if (!src || !tpl_parse(t, src))
+            return NULL;
+    }
+    return t;
+}
+
+void put_escaped(StrBuf *b, const char *s, int html)
+{
+    if (!html)
+    {
+        sb_puts(b, s);
         return;
     }
-    read_line("Title: ", c.title, sizeof(c.title));
-    c.credit = read_float("Credit (e.g., 3): ");
-    read_line("Dept: ", c.dept, sizeof(c.dept));
-    read_line("Instructor ID (optional, blank to skip): ", c.instructorId, sizeof(c.instructorId));
-    if (file_append(FILE_COURSE, sizeof(Course), &c))
-        printf("Course added.\n");
+    for (; *s; s++)
+    {
+        switch (*s)
+        {
+        case '<':
+            sb_puts(b, "&lt;");
+            break;
+        case '>':
+            sb_puts(b, "&gt;");
+            break;
+        case '&':
+            sb_puts(b, "&amp;");
+            break;
+        case '"':
+            sb_puts(b, "&quot;");
+            break;
+        default:
+            sb_put(b, s, 1);
+        }
+    }
+}
+
+void tpl_var_value(int var, const Transcript *t, const TranscriptRow *r, int html, char *out, size_t cap)
+{
+    out[0] = 0;
+    switch (var)
+    {
+    case TV_STUDENT_ID:
+        snprintf(out, cap, "%s", t->stu.id);
+        break;
+    case TV_NAME:
+        snprintf(out, cap, "%s", t->stu.name);
+        break;
+    case TV_DEPT:
+        snprintf(out, cap, "%s", t->stu.dept);
+        break;
+    case TV_BATCH:
+        snprintf(out, cap, "%d", t->stu.batch);
+        break;
+    case TV_EMAIL:
+        snprintf(out, cap, "%s", t->stu.email);
+        break;
+    case TV_CGPA:
+        if (t->credX100 > 0)
+            snprintf(out, cap, "%.2f", gpa_x100(t->qp, t->credX100) / 100.0);
+        else
+            snprintf(out, cap, "N/A");
+        break;
+    case TV_TOTAL_CREDITS:
+        snprintf(out, cap, "%.1f", t->credX100 / 100.0);
+        break;
+    case TV_GENERATED:
+    {
+        time_t now = time(NULL);
+        strftime(out, cap, "%Y-%m-%d %H:%M", localtime(&now));
+    }
+    break;
+    default:
+        if (!r)
+            break;
+        // plain-text layouts need fixed-width columns, HTML does not
+        if (var == TV_CODE)
+            snprintf(out, cap, html ? "%s" : "%-9s", r->code);
+        else if (var == TV_TITLE)
+            snprintf(out, cap, "%s", r->title);
+        else if (var == TV_TERM)
+            snprintf(out, cap, html ? "%s" : "%-11s", r->term);
+        else if (var == TV_CREDIT)
+            snprintf(out, cap, html ? "%.1f" : "%6.1f", r->credX100 / 100.0);
+        else if (var == TV_GRADE)
+            snprintf(out, cap, html ? "%s" : "%-5s", r->grade);
+        else if (var == TV_GP && r->ptsX100 >= 0)
+            snprintf(out, cap, "%.2f", r->ptsX100 / 100.0);
+        else if (var == TV_GP)
+            snprintf(out, cap, html ? "-" : "-   ");
+    }
+}
+
+void tpl_render(const Template *tp, const Transcript *t, int html, StrBuf *out)
+{
+    char val[128];
+    for (int i = 0; i < tp->n; i++)
+    {
+        const TplSeg *s = &tp->segs[i];
+        if (s->kind == SEG_TEXT)
+            sb_put(out, s->text, s->len);
+        else if (s->kind == SEG_VAR)
+        {
+            tpl_var_value(s->var, t, NULL, html, val, sizeof(val));
+            put_escaped(out, val, html);
+        }
+        else if (s->kind == SEG_ROWS_BEGIN)
+        {
+            int end = i + 1;
+            while (end < tp->n && tp->segs[end].kind != SEG_ROWS_END)
+                end++;
+            for (int r = 0; r < t->n; r++)
+                for (int j = i + 1; j < end; j++)
+                {
+                    const TplSeg *rs = &tp->segs[j];
+                    if (rs->kind == SEG_TEXT)
+                        sb_put(out, rs->text, rs->len);
+                    else if (rs->kind == SEG_VAR)
+                    {
+                        tpl_var_value(rs->var, t, &t->rows[r], html, val, sizeof(val));
+                        put_escaped(out, val, html);
+                    }
+                }
+            i = end;
+        }
+    }
+}
+
+/* Minimal PDF 1.4 writer: A4 pages of Courier text, one line per '\n' */
+void pdf_from_text(const char *text, StrBuf *pdf)
+{
+    enum
+    {
+        LINES_PER_PAGE = 60
+    };
+    int lines = 1;
+    for (const char *p = text; *p; p++)
+        lines += (*p == '\n');
+    int pages = (lines + LINES_PER_PAGE - 1) / LINES_PER_PAGE;
+    int nobj = 3 + 2 * pages;
+    long *offs = (long *)calloc((size_t)nobj + 1, sizeof(long));
+    if (!offs)
+        return;
+
+    sb_puts(pdf, "%PDF-1.4\n");
+    offs[1] = (long)pdf->n;
+    sb_puts(pdf, "1 0 obj << /Type /Catalog /Pages 2 0 R >> endobj\n");
+    offs[2] = (long)pdf->n;
+    sb_puts(pdf, "2 0 obj << /Type /Pages /Kids [");
+    for (int i = 0; i < pages; i++)
+        sb_printf(pdf, "%d 0 R ", 4 + 2 * i);
+    sb_printf(pdf, "] /Count %d >> endobj\n", pages);
+    offs[3] = (long)pdf->n;
+    sb_puts(pdf, "3 0 obj << /Type /Font /Subtype /Type1 /BaseFont /Courier >> endobj\n");
+
+    const char *p = text;
+    for (int pg = 0; pg < pages; pg++)
+    {
+        StrBuf cs = {0};
+        sb_puts(&cs, "BT /F1 10 Tf 12 TL 50 790 Td\n");
+        for (int l = 0; l < LINES_PER_PAGE && *p; l++)
+        {
+            sb_puts(&cs, "(");
+            for (; *p && *p != '\n'; p++)
+            {
+                if (*p == '(' || *p == ')' || *p == '\\')
+                    sb_puts(&cs, "\\");
+                sb_put(&cs, p, 1);
+            }
+            if (*p == '\n')
+                p++;
+            sb_puts(&cs, ") '\n");
+        }
+        sb_puts(&cs, "ET\n");
+        int pageObj = 4 + 2 * pg;
+        offs[pageObj] = (long)pdf->n;
+        sb_printf(pdf, "%d 0 obj << /Type /Page /Parent 2 0 R /MediaBox [0 0 595 842] "
+                       "/Resources << /Font << /F1 3 0 R >> >> /Contents %d 0 R >> endobj\n",
+                  pageObj, pageObj + 1);
+        offs[pageObj + 1] = (long)pdf->n;
+        sb_printf(pdf, "%d 0 obj << /Length %lu >> stream\n", pageObj + 1, (unsigned long)cs.n);
+        sb_put(pdf, cs.p ? cs.p : "", cs.n);
+        sb_puts(pdf, "endstream endobj\n");
+        sb_free(&cs);
+    }
+
+    long xref = (long)pdf->n;
+    sb_printf(pdf, "xref\n0 %d\n0000000000 65535 f \n", nobj + 1);
+    for (int i = 1; i <= nobj; i++)
+        sb_printf(pdf, "%010ld 00000 n \n", offs[i]);
+    sb_printf(pdf, "trailer << /Size %d /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n", nobj + 1, xref);
+    free(offs);
+}
+
+enum
+{
+    EXPORT_HTML = 1,
+    EXPORT_PDF = 2
+};
+
+int write_whole_file(const char *path, const char *data, size_t len)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return 0;
+    int ok = fwrite(data, 1, len, fp) == len;
+    fclose(fp);
+    return ok;
+}
+
+int render_transcript_files(const Transcript *t, const char *dir, int formats)
+{
+    char name[MAX_ID + 18], path[512];
+    StrBuf out = {0};
+    int ok = 1;
+    unique_filename(t->stu.id, name, sizeof(name)); // "A/1" and "A_1" must not share a file
+    if (formats & EXPORT_HTML)
+    {
+        const Template *tp = tpl_get(&g_tpl_html, "transcript_html.tpl", TPL_HTML_DEFAULT);
+        if (!tp)
+            return 0;
+        tpl_render(tp, t, 1, &out);
+        snprintf(path, sizeof(path), "%s/%s.html", dir, name);
+        ok &= write_whole_file(path, out.p ? out.p : "", out.n);
+        out.n = 0;
+    }
+    if (formats & EXPORT_PDF)
+    {
+        const Template *tp = tpl_get(&g_tpl_pdf, "transcript_pdf.tpl", TPL_PDF_DEFAULT);
+        if (!tp)
+            return 0;
+        StrBuf text = {0};
+        tpl_render(tp, t, 0, &text);
+        pdf_from_text(text.p ? text.p : "", &out);
+        sb_free(&text);
+        snprintf(path, sizeof(path), "%s/%s.pdf", dir, name);
+        ok &= write_whole_file(path, out.p ? out.p : "", out.n);
+    }
+    sb_free(&out);
+    return ok;
+}
+
+int cmp_enr_student(const void *a, const void *b)
+{
+    return strcmp(((const Enrollment *)a)->studentId, ((const Enrollment *)b)->studentId);
+}
+
+/* Render transcripts for one student (sid) or everyone (sid empty) into dir.
+ * All tables are loaded once and enrollments grouped by student, so each
+ * transcript is a binary search plus a short contiguous walk. */
+void export_transcripts(const char *dir, const char *sid, int formats)
+{
+    trace_args("dir=%s sid=%s", dir, sid[0] ? redact_id(sid) : "*");
+    MKDIR(dir); // may already exist; the writes below report real failures
+    long ns, ne, nc;
+    Student *studs = (Student *)file_load_all(FILE_STUD, sizeof(Student), &ns);
+    Enrollment *enr = (Enrollment *)file_load_all(FILE_ENR, sizeof(Enrollment), &ne);
+    long na;
+    Enrollment *arch = archive_rows(NULL, NULL, &na);
+    if (na)
+    {
+        Enrollment *all = (Enrollment *)realloc(enr, (size_t)(ne + na) * sizeof(Enrollment));
+        if (all)
+        {
+            memcpy(all + ne, arch, (size_t)na * sizeof(Enrollment));
+            enr = all;
+            ne += na;
+        }
+    }
+    free(arch);
+    Course *cs = courses_load_sorted(&nc);
+    if (enr)
+        qsort(enr, (size_t)ne, sizeof(Enrollment), cmp_enr_student);
+
+    clock_t t0 = clock();
+    int done = 0, failed = 0;
+    for (long i = 0; i < ns; i++)
+    {
+        if (sid[0] && strcmp(studs[i].id, sid) != 0)
+            continue;
+        long lo = 0, hi = ne;
+        while (lo < hi) // first enrollment row of this student
+        {
+            long mid = (lo + hi) / 2;
+            if (strcmp(enr[mid].studentId, studs[i].id) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        long end = lo;
+        while (end < ne && strcmp(enr[end].studentId, studs[i].id) == 0)
+            end++;
+        Transcript t;
+        transcript_build(&t, &studs[i], studs[i].id, enr ? enr + lo : NULL, end - lo, cs, nc);
+        if (render_transcript_files(&t, dir, formats))
+            done++;
+        else
+            failed++;
+        transcript_free(&t);
+    }
+    double secs = (double)(clock() - t0) / CLOCKS_PER_SEC;
+    free(studs);
+    free(enr);
+    free(cs);
+    if (!done && !failed)
+        printf("No matching students.\n");
     else
-        printf("Write error.\n");
+        printf("Rendered %d transcript(s) into %s in %.3f s%s\n", done, dir, secs,
+               failed ? " (some files could not be written)" : "");
+}
+
+/* ======== ROSTER SNAPSHOTS ========
+ * Faculty roster views (Faculty > View Roster) read a frozen copy of the
+ * term, not enrollments.dat, which other faculty are writing grades to.
+ * A snapshot holds every row of one term (live and archived) with the
+ * student's name, sorted by course code and then student ID.  A roster is
+ * then one binary search plus a range read, with no file access at all.
+ * The program is single-threaded: a snapshot is an array that is not
+ * changed once built, and a refresh builds a new one and swaps it in.
+ * Snapshots older than roster_snapshot_secs are refreshed at the faculty
+ * menu's idle point if they were read since their last build, and on
+ * demand otherwise.  roster_snapshot_secs = 0 reads live data.
+ *
+ * Grades, enrollments and student names written by this process go to a
+ * small overlay on the snapshot (rows keyed by code and student, names
+ * keyed by student) that is applied when a roster is read, so a writer
+ * sees its own changes at once and no write rebuilds a term.  A full
+ * overlay makes the next read rebuild the term instead.  Writes by other
+ * processes show up at the next refresh.
+ */
+#define ROSTER_TERMS 8
+#define ROSTER_PATCH_MAX 64 // overlay rows per snapshot before a rebuild
+
+typedef struct
+{
+    char code[MAX_CODE];
+    char sid[MAX_ID];
+    char name[MAX_NAME];
+    char grade[3];
+} RosterRow;
+
+typedef struct
+{
+    const Tenant *tenant; // campus the rows belong to
+    char term[MAX_TERM];
+    RosterRow *rows; // sorted by code, then sid; read-only once built
+    int32_t n;
+    RosterRow *patch; // own writes since the build; code "" = name only
+    int32_t nPatch;
+    time_t built;
+    unsigned long lastUse;
+    long reads; // since the last build
+} RosterSnap;
+
+static RosterSnap g_rosters[ROSTER_TERMS];
+static unsigned long g_rosterClock;
+static long g_rosterBuilds, g_rosterReads;
+
+int cmp_roster_row(const void *a, const void *b)
+{
+    const RosterRow *x = (const RosterRow *)a, *y = (const RosterRow *)b;
+    int c = strcmp(x->code, y->code);
+    return c ? c : strcmp(x->sid, y->sid);
+}
+
+void roster_snap_free(RosterSnap *rs)
+{
+    big_free(rs->rows);
+    free(rs->patch);
+    memset(rs, 0, sizeof(*rs));
 }
 
-void assign_instructor()
+long roster_mem_usage()
 {
-    char code[MAX_CODE], fid[MAX_ID];
-    read_line("Course code: ", code, sizeof(code));
-    Course c;
-    long idx = file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, code, &c);
-    if (idx < 0)
-    {
-        printf("Course not found.\n");
-        return;
-    }
-    read_line("Faculty ID: ", fid, sizeof(fid));
-    if (file_find_first(FILE_FAC, sizeof(Faculty), pred_faculty_by_id, fid, NULL) < 0)
-    {
-        printf("Faculty not found.\n");
-        return;
-    }
-    strncpy(c.instructorId, fid, MAX_ID);
-    if (file_write_at(FILE_COURSE, sizeof(Course), idx, &c))
-        printf("Instructor assigned.\n");
-    else
-        printf("Write error.\n");
+    long bytes = 0;
+    for (int i = 0; i < ROSTER_TERMS; i++)
+        bytes += (long)(g_rosters[i].n + (g_rosters[i].patch ? ROSTER_PATCH_MAX : 0)) * (long)sizeof(RosterRow);
+    return bytes;
 }
 
-void list_courses()
+void roster_evict_all()
 {
-    OPEN_BIN_READ(FILE_COURSE, fp);
-    if (!fp)
-    {
-        printf("No courses yet.\n");
-        return;
-    }
-    Course c;
-    printf("\n-- Courses --\n");
-    while (fread(&c, sizeof(Course), 1, fp) == 1)
-        print_course(&c);
-    fclose(fp);
+    for (int i = 0; i < ROSTER_TERMS; i++)
+        roster_snap_free(&g_rosters[i]);
 }
 
-void enroll_student()
+/* Write hook: add a row (code set) or a student's name (code "") to the
+ * overlay of the active campus's snapshot of term (of every term when
+ * NULL).  A later write to the same key replaces the entry. */
+void roster_patch(const char *term, const char *code, const char *sid, const char *name, const char *grade)
 {
-    Enrollment e = {0};
-    read_line("Student ID: ", e.studentId, sizeof(e.studentId));
-    if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, e.studentId, NULL) < 0)
+    for (int i = 0; i < ROSTER_TERMS; i++)
     {
-        printf("Student not found.\n");
-        return;
+        RosterSnap *rs = &g_rosters[i];
+        if (!rs->rows || !rs->built || rs->tenant != g_tenant || (term && strcmp(rs->term, term) != 0))
+            continue; // stale ones are rebuilt from the file anyway
+        int32_t k = 0;
+        while (k < rs->nPatch && (strcmp(rs->patch[k].code, code) != 0 || strcmp(rs->patch[k].sid, sid) != 0))
+            k++;
+        if (k == rs->nPatch)
+        {
+            if (!rs->patch)
+                rs->patch = (RosterRow *)malloc(ROSTER_PATCH_MAX * sizeof(RosterRow));
+            if (!rs->patch || rs->nPatch == ROSTER_PATCH_MAX)
+            {
+                rs->built = 0; // overlay full: rebuild on the next read
+                continue;
+            }
+            rs->nPatch++;
+        }
+        RosterRow *r = &rs->patch[k];
+        snprintf(r->code, MAX_CODE, "%s", code);
+        snprintf(r->sid, MAX_ID, "%s", sid);
+        snprintf(r->name, MAX_NAME, "%s", name);
+        snprintf(r->grade, sizeof(r->grade), "%s", grade);
     }
-    read_line("Course code: ", e.courseCode, sizeof(e.courseCode));
-    Course c;
-    if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, e.courseCode, &c) < 0)
+}
+
+/* Build a fresh snapshot of term into rs, replacing the old rows only on
+ * success */
+int roster_build(RosterSnap *rs, const char *term)
+{
+    trace_begin("snapshot", "roster_build", "%s", term);
+    long nl, na, ns;
+    Enrollment *live = enr_scan(term, NULL, NULL, &nl); // term index / zone maps
+    Enrollment *arch = archive_rows(term, NULL, &na);
+    Student *stu = (Student *)file_load_all(FILE_STUD, sizeof(Student), &ns);
+    if (stu)
+        qsort(stu, (size_t)ns, sizeof(Student), cmp_sid);
+    RosterRow *rows = (RosterRow *)big_alloc((size_t)(nl + na + 1) * sizeof(RosterRow));
+    int32_t n = 0;
+    for (long i = 0; rows && stu && i < nl + na; i++)
     {
-        printf("Course not found.\n");
-        return;
+        const Enrollment *e = i < nl ? &live[i] : &arch[i - nl];
+        const Student *s = (const Student *)bsearch(e->studentId, stu, (size_t)ns, sizeof(Student), cmp_sid);
+        if (!s)
+            continue; // the live roster skips unknown students too
+        RosterRow *r = &rows[n++];
+        memcpy(r->code, e->courseCode, MAX_CODE);
+        memcpy(r->sid, e->studentId, MAX_ID);
+        memcpy(r->name, s->name, MAX_NAME);
+        memcpy(r->grade, e->grade, 3);
     }
-    read_line("Term (e.g., Fall-2025): ", e.term, sizeof(e.term));
-    strcpy(e.grade, "NA");
-    EnrKey key;
-    strncpy(key.sid, e.studentId, MAX_ID);
-    strncpy(key.code, e.courseCode, MAX_CODE);
-    strncpy(key.term, e.term, MAX_TERM);
-    if (file_find_first(FILE_ENR, sizeof(Enrollment), pred_enr_by_key, &key, NULL) >= 0)
+    free(live);
+    free(arch);
+    free(stu);
+    if (rows)
     {
-        printf("Already enrolled.\n");
-        return;
+        qsort(rows, (size_t)n, sizeof(RosterRow), cmp_roster_row);
+        big_free(rs->rows); // the swap: readers never see a half-built array
+        rs->rows = rows;
+        rs->n = n;
+        rs->tenant = g_tenant;
+        snprintf(rs->term, MAX_TERM, "%s", term);
+        rs->built = time(NULL);
+        rs->reads = 0;
+        rs->nPatch = 0; // the new rows include this process's writes
+        g_rosterBuilds++;
     }
-    if (file_append(FILE_ENR, sizeof(Enrollment), &e))
-        printf("Enrollment added.\n");
-    else
-        printf("Write error.\n");
+    trace_args("%d rows", n);
+    trace_end();
+    return rows != NULL;
 }
 
-void set_grade()
+/* The snapshot of term for the active campus, built or refreshed as
+ * needed; NULL when snapshots are off or cannot be built */
+const RosterSnap *roster_snapshot(const char *term)
 {
-    Enrollment e;
-    char sid[MAX_ID], code[MAX_CODE], term[MAX_TERM], g[3];
-    read_line("Student ID: ", sid, sizeof(sid));
-    read_line("Course code: ", code, sizeof(code));
-    read_line("Term: ", term, sizeof(term));
-    EnrKey key;
-    strncpy(key.sid, sid, MAX_ID);
-    strncpy(key.code, code, MAX_CODE);
-    strncpy(key.term, term, MAX_TERM);
-    long idx = file_find_first(FILE_ENR, sizeof(Enrollment), pred_enr_by_key, &key, &e);
-    if (idx < 0)
+    if (!g_cfg.rosterSnapshotSecs)
+        return NULL;
+    RosterSnap *rs = NULL, *victim = &g_rosters[0];
+    for (int i = 0; i < ROSTER_TERMS && !rs; i++)
     {
-        printf("Enrollment not found.\n");
-        return;
+        RosterSnap *x = &g_rosters[i];
+        if (x->rows && x->tenant == g_tenant && strcmp(x->term, term) == 0)
+            rs = x;
+        else if (!x->rows || (victim->rows && x->lastUse < victim->lastUse))
+            victim = x;
     }
-    read_line("Grade (A, A-, B+, ... , F): ", g, sizeof(g));
-    upper(g);
-    if (grade_to_points(g) < 0 && strcmp(g, "NA") != 0)
+    if (!rs || time(NULL) - rs->built >= g_cfg.rosterSnapshotSecs)
     {
-        printf("Invalid grade.\n");
-        return;
+        if (!rs)
+            roster_snap_free(rs = victim);
+        if (!roster_build(rs, term) && !rs->built)
+            return NULL; // nothing, or only rows a write has outdated: read live
     }
-    strncpy(e.grade, g, 2);
-    e.grade[2] = 0;
-    if (file_write_at(FILE_ENR, sizeof(Enrollment), idx, &e))
-        printf("Grade updated.\n");
-    else
-        printf("Write error.\n");
+    rs->lastUse = ++g_rosterClock;
+    rs->reads++;
+    g_rosterReads++;
+    return rs;
 }
 
-void transcript_for_student(const char *sid)
+/* Idle-point hook: refresh one stale snapshot that is still being read */
+void roster_idle()
 {
-    // Print courses, terms, credits, grades, and compute CGPA
-    OPEN_BIN_READ(FILE_ENR, fp);
-    if (!fp)
-    {
-        printf("No enrollments.\n");
-        return;
-    }
-    Course c;
-    Enrollment e;
-    float totalCred = 0.0f, totalPts = 0.0f;
-    printf("\n-- Transcript for %s --\n", sid);
-    while (fread(&e, sizeof(Enrollment), 1, fp) == 1)
+    time_t now = time(NULL);
+    for (int i = 0; g_cfg.rosterSnapshotSecs && i < ROSTER_TERMS; i++)
     {
-        if (strcmp(e.studentId, sid) == 0)
+        RosterSnap *rs = &g_rosters[i];
+        if (rs->rows && rs->tenant == g_tenant && rs->reads && now - rs->built >= g_cfg.rosterSnapshotSecs)
         {
-            // lookup course
-            if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, e.courseCode, &c) >= 0)
-            {
-                float pts = grade_to_points(e.grade);
-                printf("%-8s | %-10s | %4.1f cr | Grade: %-2s", c.code, e.term, c.credit, e.grade);
-                if (pts >= 0)
-                {
-                    totalCred += c.credit;
-                    totalPts += (pts * c.credit);
-                    printf(" | GP: %.2f", pts);
-                }
-                printf("\n");
-            }
+            char term[MAX_TERM];
+            memcpy(term, rs->term, MAX_TERM);
+            roster_build(rs, term);
+            return;
         }
     }
-    fclose(fp);
-    if (totalCred > 0)
+}
+
+/* The n snapshot rows of code with rs's overlay applied: grades replaced,
+ * enrollments added, names updated.  New rows take their name from the
+ * overlay or students.dat; unknown students are left out, as in the live
+ * roster.  Returns a malloc'd array (NULL when out of memory). */
+RosterRow *roster_overlay(const RosterSnap *rs, const char *code, const RosterRow *rows, int32_t *n)
+{
+    RosterRow *out = (RosterRow *)malloc((size_t)(*n + rs->nPatch + 1) * sizeof(RosterRow));
+    if (!out)
+        return NULL;
+    int32_t m = *n, kept = 0;
+    memcpy(out, rows, (size_t)m * sizeof(RosterRow));
+    for (int32_t k = 0; k < rs->nPatch; k++)
     {
-        printf("CGPA: %.2f (%.1f total credits)\n", totalPts / totalCred, totalCred);
+        const RosterRow *p = &rs->patch[k];
+        if (strcmp(p->code, code) != 0)
+            continue;
+        int found = 0, had = m;
+        for (int32_t i = 0; i < had; i++)
+            if (strcmp(out[i].sid, p->sid) == 0)
+            {
+                memcpy(out[i].grade, p->grade, sizeof(p->grade));
+                found = 1;
+            }
+        if (!found)
+            out[m++] = *p; // name still empty
     }
-    else
+    for (int32_t i = 0; i < m; i++)
     {
-        printf("No graded credits yet.\n");
+        for (int32_t k = 0; k < rs->nPatch; k++)
+            if (!rs->patch[k].code[0] && strcmp(rs->patch[k].sid, out[i].sid) == 0)
+                memcpy(out[i].name, rs->patch[k].name, MAX_NAME);
+        Student s;
+        if (!out[i].name[0])
+        {
+            if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, out[i].sid, &s) < 0)
+                continue;
+            memcpy(out[i].name, s.name, MAX_NAME);
+        }
+        out[kept++] = out[i];
     }
+    qsort(out, (size_t)kept, sizeof(RosterRow), cmp_roster_row);
+    *n = kept;
+    return out;
 }
 
-void roster_for_course_term(const char *code, const char *term)
+/* Faculty roster: a range read on the term snapshot (live data when off) */
+void roster_from_snapshot(const char *code, const char *term)
 {
-    OPEN_BIN_READ(FILE_ENR, fp);
-    if (!fp)
+    const RosterSnap *rs = roster_snapshot(term);
+    if (!rs)
     {
-        printf("No enrollments.\n");
+        roster_for_course_term(code, term);
         return;
     }
-    Enrollment e;
-    Student s;
-    int count = 0;
-    printf("\n-- Roster %s (%s) --\n", code, term);
-    while (fread(&e, sizeof(Enrollment), 1, fp) == 1)
+    int32_t lo = 0, hi = rs->n;
+    while (lo < hi) // first row of code
     {
-        if (strcmp(e.courseCode, code) == 0 && strcmp(e.term, term) == 0)
-        {
-            if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, e.studentId, &s) >= 0)
-            {
-                printf("%-12s  %-24s  Grade: %-2s\n", s.id, s.name, e.grade);
-                count++;
-            }
-        }
+        int32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(rs->rows[mid].code, code) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    fclose(fp);
+    int32_t end = lo;
+    while (end < rs->n && strcmp(rs->rows[end].code, code) == 0)
+        end++;
+    trace_args("code=%s term=%s snapshot", code, term);
+    printf("\n-- Roster %s (%s), as of %ld s ago --\n", code, term, (long)(time(NULL) - rs->built));
+    const RosterRow *rows = rs->rows + lo;
+    int32_t count = end - lo;
+    RosterRow *merged = NULL;
+    if (rs->nPatch && (merged = roster_overlay(rs, code, rows, &count)))
+        rows = merged;
+    for (int32_t i = 0; i < count; i++)
+        printf("%-12s  %-24s  Grade: %-2s\n", rows[i].sid, rows[i].name, rows[i].grade);
     if (!count)
         printf("No students enrolled.\n");
+    free(merged);
 }
 
-void gpa_leaderboard(const char *term)
+/* ======== MEMORY BUDGET ========
+ * One table of everything that holds memory beyond a request: caches,
+ * indexes, parked campuses and fixed buffers.  Each entry reports its
+ * usage; droppable ones also have an evict function and a priority.
+ * Everything droppable is derived data and is rebuilt (or reloaded from
+ * its file) on next use.  At idle points, when the total is over
+ * memory_budget_mb, entries are dropped in priority order (cheapest to
+ * rebuild first) until the total is back under 90% of the budget.  While
+ * under pressure the background index builder pauses, so it does not
+ * rebuild what was just dropped.  The breakdown is in System Stats.
+ */
+#define MEM_LOW_WATER 0.90 // evict down to this share of the budget
+#define MEM_CLEAR 0.75     // pressure ends below this share
+
+long serve_mem_usage();
+
+long mem_parked_usage()
 {
-    // naive: compute term GPA for each student enrolled in that term
-    OPEN_BIN_READ(FILE_ENR, fp);
-    if (!fp)
+    long bytes = 0;
+    for (int i = 0; i < g_nTenants; i++)
+        if (&g_tenants[i] != g_tenant)
+            bytes += tenant_mem_usage(&g_tenants[i]);
+    return bytes;
+}
+
+void mem_parked_evict()
+{
+    for (int i = 0; i < g_nTenants; i++)
+        if (&g_tenants[i] != g_tenant && tenant_mem_usage(&g_tenants[i]))
+            tenant_drop_parked(&g_tenants[i], 0);
+}
+
+long mem_reports_usage()
+{
+    return report_cache_mem_usage(&g_reports);
+}
+
+void mem_reports_evict()
+{
+    report_cache_clear(&g_reports);
+}
+
+long mem_coterm_usage()
+{
+    long bytes = 0;
+    for (int i = 0; i < COENR_MAX_TERMS; i++)
+        bytes += coterm_mem_usage(&g_coterm[i]);
+    return bytes;
+}
+
+void mem_coterm_evict()
+{
+    for (int i = 0; i < COENR_MAX_TERMS; i++)
+        coterm_free(&g_coterm[i]);
+}
+
+long mem_zones_usage()
+{
+    return zone_mem_usage(&g_zones);
+}
+
+void mem_zones_evict()
+{
+    if (g_zones.dirty)
+        zone_save(&g_zones);
+    zone_set_free(&g_zones);
+}
+
+long mem_index_usage()
+{
+    long bytes = 0;
+    for (int i = 0; i < IDX_COUNT; i++)
+        bytes += sec_index_mem_usage(&g_idx[i]);
+    return bytes;
+}
+
+void mem_index_evict()
+{
+    for (int i = 0; i < IDX_COUNT; i++)
+        sec_index_free(&g_idx[i]);
+}
+
+long mem_adj_usage()
+{
+    return adj_mem_usage(&g_adj);
+}
+
+void mem_adj_evict()
+{
+    if (g_adj.dirty)
+        adj_save(&g_adj);
+    adj_list_free(&g_adj.byStudent);
+    adj_list_free(&g_adj.byCourse);
+    memset(&g_adj, 0, sizeof(g_adj));
+}
+
+long mem_snapq_usage()
+{
+    return (long)g_snapDirtyCap * MAX_ID;
+}
+
+long mem_templates_usage()
+{
+    long bytes = 0;
+    const Template *t[2] = {&g_tpl_html, &g_tpl_pdf};
+    for (int i = 0; i < 2; i++)
+        if (t[i]->loaded)
+            bytes += (long)(strlen(t[i]->src) + 1 + (size_t)t[i]->n * sizeof(TplSeg));
+    return bytes;
+}
+
+/* In eviction order; evict == NULL: fixed, reported only */
+static const struct
+{
+    const char *name;
+    long (*usage)();
+    void (*evict)();
+} MEM_CONSUMERS[] = {
+    {"parked campuses", mem_parked_usage, mem_parked_evict},
+    {"report cache", mem_reports_usage, mem_reports_evict},
+    {"roster snapshots", roster_mem_usage, roster_evict_all},
+    {"co-enrollment", mem_coterm_usage, mem_coterm_evict},
+    {"zone maps", mem_zones_usage, mem_zones_evict},
+    {"secondary indexes", mem_index_usage, mem_index_evict},
+    {"enrollment adjacency", mem_adj_usage, mem_adj_evict},
+    {"snapshot queue", mem_snapq_usage, NULL},
+    {"export templates", mem_templates_usage, NULL},
+    {"serve buffers", serve_mem_usage, NULL},
+};
+#define MEM_CONSUMER_COUNT (int)(sizeof(MEM_CONSUMERS) / sizeof(MEM_CONSUMERS[0]))
+
+static long g_memEvictions[MEM_CONSUMER_COUNT], g_memFreed[MEM_CONSUMER_COUNT];
+
+long mem_total()
+{
+    long bytes = 0;
+    for (int i = 0; i < MEM_CONSUMER_COUNT; i++)
+        bytes += MEM_CONSUMERS[i].usage();
+    return bytes;
+}
+
+/* Idle-point hook: bring the total back under budget */
+void mem_enforce()
+{
+    long budget = g_cfg.memBudgetMb << 20, total = mem_total();
+    if (!budget || total <= budget)
     {
-        printf("No enrollments.\n");
+        if (!budget || total < budget * MEM_CLEAR)
+            g_memPressure = 0;
         return;
     }
-    typedef struct
-    {
-        char sid[MAX_ID];
-        float pts;
-        float cred;
-    } Acc;
-    Acc accs[2048];
-    int n = 0;
-    Enrollment e;
-    Course c;
-    while (fread(&e, sizeof(Enrollment), 1, fp) == 1)
+    trace_begin("memory", "mem_enforce", "%.1f of %ld MB", total / 1048576.0, g_cfg.memBudgetMb);
+    for (int i = 0; i < MEM_CONSUMER_COUNT && total > budget * MEM_LOW_WATER; i++)
     {
-        if (strcmp(e.term, term) == 0)
-        {
-            if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, e.courseCode, &c) >= 0)
-            {
-                float gp = grade_to_points(e.grade);
-                if (gp < 0)
-                    continue; // ungraded
-                int found = -1;
-                for (int i = 0; i < n; i++)
-                    if (strcmp(accs[i].sid, e.studentId) == 0)
-                    {
-                        found = i;
-                        break;
-                    }
-                if (found < 0)
-                {
-                    strncpy(accs[n].sid, e.studentId, MAX_ID);
-                    accs[n].pts = 0;
-                    accs[n].cred = 0;
-                    found = n;
-                    n++;
-                }
-                accs[found].pts += gp * c.credit;
-                accs[found].cred += c.credit;
-            }
-        }
+        long used = MEM_CONSUMERS[i].usage();
+        if (!MEM_CONSUMERS[i].evict || !used)
+            continue;
+        MEM_CONSUMERS[i].evict();
+        g_memEvictions[i]++;
+        g_memFreed[i] += used - MEM_CONSUMERS[i].usage();
+        total = mem_total();
     }
-    fclose(fp);
-    // simple bubble sort by GPA desc
-    for (int i = 0; i < n; i++)
-        for (int j = 0; j + 1 < n; j++)
-        {
-            float g1 = (accs[j].cred > 0) ? accs[j].pts / accs[j].cred : 0;
-            float g2 = (accs[j + 1].cred > 0) ? accs[j + 1].pts / accs[j + 1].cred : 0;
-            if (g2 > g1)
-            {
-                Acc t = accs[j];
-                accs[j] = accs[j + 1];
-                accs[j + 1] = t;
-            }
-        }
-    printf("\n-- Term GPA Leaderboard: %s --\n", term);
-    for (int i = 0; i < n; i++)
+    g_memPressure = 1;
+    trace_args("now %.1f MB", total / 1048576.0);
+    trace_end();
+}
+
+void mem_stats()
+{
+    long total = mem_total();
+    if (g_cfg.memBudgetMb)
+        printf("Memory: %.1f MB of %ld MB budget%s\n", total / 1048576.0, g_cfg.memBudgetMb,
+               g_memPressure ? " (under pressure: index builds paused)" : "");
+    else
+        printf("Memory: %.1f MB (no budget)\n", total / 1048576.0);
+    for (int i = 0; i < MEM_CONSUMER_COUNT; i++)
     {
-        float gpa = (accs[i].cred > 0) ? accs[i].pts / accs[i].cred : 0;
-        Student s;
-        if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, accs[i].sid, &s) >= 0)
-        {
-            printf("%2d) %-12s %-24s GPA: %.2f (%.1f cr)\n", i + 1, s.id, s.name, gpa, accs[i].cred);
-        }
+        printf("  %-21s %10.1f KB", MEM_CONSUMERS[i].name, MEM_CONSUMERS[i].usage() / 1024.0);
+        if (!MEM_CONSUMERS[i].evict)
+            printf("  fixed\n");
+        else if (g_memEvictions[i])
+            printf("  evicted %ld time(s), %.1f MB freed\n", g_memEvictions[i], g_memFreed[i] / 1048576.0);
         else
-        {
-            printf("%2d) %-12s GPA: %.2f (%.1f cr)\n", i + 1, accs[i].sid, gpa, accs[i].cred);
-        }
+            printf("\n");
+    }
+}
+
+/* ======== STATS ======== */
+void show_stats()
+{
+    printf("\n-- System Stats --\n");
+    config_print();
+    printf("Campuses:\n");
+    for (int i = 0; i < g_nTenants; i++)
+    {
+        const Tenant *t = &g_tenants[i];
+        printf("  %-12s %-24s caches %.1f KB%s\n", t->name, t->root, tenant_mem_usage(t) / 1024.0,
+               t == g_tenant ? "  (active)" : "");
     }
+    printf("Enrollment records: %ld\n", file_count_records(FILE_ENR, sizeof(Enrollment)));
+    if (g_adj.built)
+        printf("Adjacency: %d students, %d courses, %d refs%s\n", g_adj.byStudent.nkeys, g_adj.byCourse.nkeys,
+               g_adj.nEnr, g_adj.dirty ? " (unsaved)" : "");
+    int terms = 0;
+    for (int i = 0; i < COENR_MAX_TERMS; i++)
+        terms += g_coterm[i].codes != NULL;
+    printf("Co-enrollment terms cached: %d / %ld\n", terms, g_cfg.coenrollTerms);
+    printf("GPA kernel: %s\n", gpa_kernel_name());
+    if (g_zones.built)
+        printf("Zone maps: %d blocks of %d; scans skipped %ld of %ld blocks\n", g_zones.nZones, ZONE_BLOCK,
+               g_zones.skipped, g_zones.scanned);
+    archive_stats();
+    index_stats();
+    printf("Student snapshots: %ld served, %ld built, %d queued\n", g_snapHits, g_snapBuilds, g_snapDirtyN);
+    printf("Report cache: %ld hits, %ld misses, %ld invalidated\n", g_reports.hits, g_reports.misses,
+           g_reports.invalidated);
+    printf("Roster snapshots: %ld reads, %ld builds\n", g_rosterReads, g_rosterBuilds);
+    mem_stats();
+    printf("Large blocks: %ld live, %ld huge-page mapped (%ld hugetlb), %.1f MB mapped\n", g_big.blocks,
+           g_big.mapped, g_big.hugetlb, g_big.mappedBytes / 1048576.0);
 }
 
 /* ======== USERS / AUTH ======== */
@@ -798,6 +6234,19 @@ Session login()
 }
 
 /* ======== MENUS ======== */
+/* Span names for menu actions, indexed by menu number */
+static const char *ADMIN_OPS[] = {
+    "logout", "add_student", "edit_student", "list_students", "add_faculty", "list_faculty", "add_course",
+    "assign_instructor", "list_courses", "enroll_student", "set_grade", "transcript", "roster",
+    "gpa_leaderboard", "export_transcripts", "related_courses", "stats", "register_courses", "archive_term",
+    "bulk_import"};
+static const char *FACULTY_OPS[] = {"logout", "faculty_courses", "faculty_roster", "faculty_grade"};
+static const char *STUDENT_OPS[] = {"logout", "student_profile", "student_transcript", "student_courses",
+                                    "student_register"};
+#define ADMIN_OP_COUNT (int)(sizeof(ADMIN_OPS) / sizeof(ADMIN_OPS[0]))
+#define FACULTY_OP_COUNT (int)(sizeof(FACULTY_OPS) / sizeof(FACULTY_OPS[0]))
+#define STUDENT_OP_COUNT (int)(sizeof(STUDENT_OPS) / sizeof(STUDENT_OPS[0]))
+
 void menu_admin();
 void menu_faculty(const User *u);
 void menu_student(const User *u);
@@ -806,6 +6255,10 @@ void menu_admin()
 {
     while (1)
     {
+        config_poll();
+        snapshot_flush(SNAP_FLUSH_BATCH);
+        mem_enforce();
+        index_idle();
         printf("\n==== ADMIN MENU ====\n");
         printf("1. Add Student\n");
         printf("2. Edit Student\n");
@@ -820,10 +6273,17 @@ void menu_admin()
         printf("11. Transcript (by Student ID)\n");
         printf("12. Course Roster (code+term)\n");
         printf("13. Term GPA Leaderboard\n");
+        printf("14. Export Transcripts (HTML/PDF)\n");
+        printf("15. Related Courses (co-enrollment)\n");
+        printf("16. System Stats\n");
+        printf("17. Registration Cart (several courses at once)\n");
+        printf("18. Archive Closed Term\n");
+        printf("19. Bulk Import (CSV, resumable)\n");
         printf("0. Logout\n");
         int ch = read_int("Choose: ");
         if (ch == 0)
             break;
+        trace_begin("menu", (ch > 0 && ch < ADMIN_OP_COUNT) ? ADMIN_OPS[ch] : "invalid", NULL);
         switch (ch)
         {
         case 1:
@@ -865,23 +6325,156 @@ void menu_admin()
         break;
         case 12:
         {
-            char code[MAX_CODE], term[MAX_TERM];
-            read_line("Course code: ", code, sizeof(code));
-            read_line("Term: ", term, sizeof(term));
-            roster_for_course_term(code, term);
+            char code[MAX_CODE], term[MAX_TERM];
+            read_line("Course code: ", code, sizeof(code));
+            read_line("Term: ", term, sizeof(term));
+            roster_for_course_term(code, term);
+        }
+        break;
+        case 13:
+        {
+            char term[MAX_TERM];
+            read_line("Term: ", term, sizeof(term));
+            gpa_leaderboard(term);
+        }
+        break;
+        case 14:
+        {
+            char dir[256], sid[MAX_ID], fmt[16];
+            read_line("Output folder: ", dir, sizeof(dir));
+            read_line("Student ID (blank for all): ", sid, sizeof(sid));
+            read_line("Format (html/pdf/both): ", fmt, sizeof(fmt));
+            upper(fmt);
+            int formats = strcmp(fmt, "HTML") == 0 ? EXPORT_HTML : strcmp(fmt, "PDF") == 0 ? EXPORT_PDF
+                                                                                          : EXPORT_HTML | EXPORT_PDF;
+            if (!dir[0])
+                strcpy(dir, "transcripts");
+            export_transcripts(dir, sid, formats);
+        }
+        break;
+        case 15:
+        {
+            char code[MAX_CODE], term[MAX_TERM];
+            read_line("Course code: ", code, sizeof(code));
+            read_line("Term: ", term, sizeof(term));
+            int n = read_int("How many (e.g., 5): ");
+            related_courses(code, term, n > 0 ? n : 5);
+        }
+        break;
+        case 16:
+            show_stats();
+            break;
+        case 17:
+            register_courses(NULL);
+            break;
+        case 18:
+        {
+            char term[MAX_TERM];
+            read_line("Term to archive (all grades posted): ", term, sizeof(term));
+            if (term[0])
+                archive_term(term);
+        }
+        break;
+        case 19:
+            bulk_import();
+            break;
+        default:
+            printf("Invalid.\n");
+        }
+        trace_end();
+    }
+}
+
+void faculty_list_courses(const User *u)
+{
+    OPEN_BIN_READ(FILE_COURSE, fp);
+    if (!fp)
+    {
+        printf("No courses.\n");
+        return;
+    }
+    Course c;
+    int any = 0;
+    int32_t n;
+    const IdxEntry *mine = index_range(IDX_COURSE_INSTRUCTOR, u->refId, &n);
+    for (int32_t i = 0; mine && i < n; i++)
+        if (fseek(fp, (long)mine[i].ref * (long)sizeof(Course), SEEK_SET) == 0 &&
+            fread(&c, sizeof(Course), 1, fp) == 1 && strcmp(c.instructorId, u->refId) == 0)
+        {
+            trace_io(1, (long)sizeof(Course));
+            print_course(&c);
+            any = 1;
         }
-        break;
-        case 13:
+    while (!mine && fread(&c, sizeof(Course), 1, fp) == 1) // index not built yet
+    {
+        trace_io(1, (long)sizeof(Course));
+        if (strcmp(c.instructorId, u->refId) == 0)
         {
-            char term[MAX_TERM];
-            read_line("Term: ", term, sizeof(term));
-            gpa_leaderboard(term);
-        }
-        break;
-        default:
-            printf("Invalid.\n");
+            print_course(&c);
+            any = 1;
         }
     }
+    fclose(fp);
+    if (!any)
+        printf("No assigned courses.\n");
+}
+
+void faculty_view_roster(const User *u)
+{
+    char code[MAX_CODE], term[MAX_TERM];
+    read_line("Course code: ", code, sizeof(code));
+    read_line("Term: ", term, sizeof(term));
+    // Validate the course belongs to faculty
+    Course c;
+    if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, code, &c) < 0 || strcmp(c.instructorId, u->refId) != 0)
+    {
+        printf("You are not the instructor of this course.\n");
+        return;
+    }
+    roster_from_snapshot(code, term);
+}
+
+void faculty_set_grade(const User *u)
+{
+    char code[MAX_CODE], term[MAX_TERM], sid[MAX_ID];
+    read_line("Course code: ", code, sizeof(code));
+    read_line("Term: ", term, sizeof(term));
+    Course c;
+    if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, code, &c) < 0 || strcmp(c.instructorId, u->refId) != 0)
+    {
+        printf("You are not the instructor of this course.\n");
+        return;
+    }
+    read_line("Student ID: ", sid, sizeof(sid));
+    trace_args("sid=%s code=%s term=%s", redact_id(sid), code, term);
+    Enrollment e;
+    EnrKey key;
+    strncpy(key.sid, sid, MAX_ID);
+    strncpy(key.code, code, MAX_CODE);
+    strncpy(key.term, term, MAX_TERM);
+    long idx = file_find_first(FILE_ENR, sizeof(Enrollment), pred_enr_by_key, &key, &e);
+    if (idx < 0)
+    {
+        printf("Enrollment not found.\n");
+        return;
+    }
+    char g[3];
+    read_line("Grade (A, A-, B+, ..., F): ", g, sizeof(g));
+    upper(g);
+    if (grade_to_points(g) < 0 && strcmp(g, "NA") != 0)
+    {
+        printf("Invalid grade.\n");
+        return;
+    }
+    strncpy(e.grade, g, 2);
+    e.grade[2] = 0;
+    if (file_write_at(FILE_ENR, sizeof(Enrollment), idx, &e))
+    {
+        on_grade_changed(&e);
+        printf("Grade saved.\n");
+    }
+    else
+        printf("Write error.\n");
 }
 
 void menu_faculty(const User *u)
@@ -889,6 +6482,11 @@ void menu_faculty(const User *u)
     // faculty id in u->refId
     while (1)
     {
+        config_poll();
+        snapshot_flush(SNAP_FLUSH_BATCH);
+        mem_enforce();
+        index_idle();
+        roster_idle();
         printf("\n==== FACULTY MENU ====\n");
         printf("1. List My Courses\n");
         printf("2. View Roster for a Course+Term\n");
@@ -897,84 +6495,16 @@ void menu_faculty(const User *u)
         int ch = read_int("Choose: ");
         if (ch == 0)
             break;
+        trace_begin("menu", (ch > 0 && ch < FACULTY_OP_COUNT) ? FACULTY_OPS[ch] : "invalid", NULL);
         if (ch == 1)
-        {
-            OPEN_BIN_READ(FILE_COURSE, fp);
-            if (!fp)
-            {
-                printf("No courses.\n");
-                continue;
-            }
-            Course c;
-            int any = 0;
-            while (fread(&c, sizeof(Course), 1, fp) == 1)
-            {
-                if (strcmp(c.instructorId, u->refId) == 0)
-                {
-                    print_course(&c);
-                    any = 1;
-                }
-            }
-            fclose(fp);
-            if (!any)
-                printf("No assigned courses.\n");
-        }
+            faculty_list_courses(u);
         else if (ch == 2)
-        {
-            char code[MAX_CODE], term[MAX_TERM];
-            read_line("Course code: ", code, sizeof(code));
-            read_line("Term: ", term, sizeof(term));
-            // Validate the course belongs to faculty
-            Course c;
-            if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, code, &c) < 0 || strcmp(c.instructorId, u->refId) != 0)
-            {
-                printf("You are not the instructor of this course.\n");
-                continue;
-            }
-            roster_for_course_term(code, term);
-        }
+            faculty_view_roster(u);
         else if (ch == 3)
-        {
-            char code[MAX_CODE], term[MAX_TERM], sid[MAX_ID];
-            read_line("Course code: ", code, sizeof(code));
-            read_line("Term: ", term, sizeof(term));
-            Course c;
-            if (file_find_first(FILE_COURSE, sizeof(Course), pred_course_by_code, code, &c) < 0 || strcmp(c.instructorId, u->refId) != 0)
-            {
-                printf("You are not the instructor of this course.\n");
-                continue;
-            }
-            read_line("Student ID: ", sid, sizeof(sid));
-            Enrollment e;
-            EnrKey key;
-            strncpy(key.sid, sid, MAX_ID);
-            strncpy(key.code, code, MAX_CODE);
-            strncpy(key.term, term, MAX_TERM);
-            long idx = file_find_first(FILE_ENR, sizeof(Enrollment), pred_enr_by_key, &key, &e);
-            if (idx < 0)
-            {
-                printf("Enrollment not found.\n");
-                continue;
-            }
-            char g[3];
-            read_line("Grade (A, A-, B+, ..., F): ", g, sizeof(g));
-            upper(g);
-            if (grade_to_points(g) < 0 && strcmp(g, "NA") != 0)
-            {
-                printf("Invalid grade.\n");
-                continue;
-            }
-            strncpy(e.grade, g, 2);
-            e.grade[2] = 0;
-            if (file_write_at(FILE_ENR, sizeof(Enrollment), idx, &e))
-                printf("Grade saved.\n");
-            else
-                printf("Write error.\n");
-        }
+            faculty_set_grade(u);
         else
-        {
             printf("Invalid.\n");
-        }
+        trace_end();
     }
 }
 
@@ -983,46 +6513,610 @@ void menu_student(const User *u)
     // student id in u->refId
     while (1)
     {
+        config_poll();
+        snapshot_flush(SNAP_FLUSH_BATCH);
+        mem_enforce();
+        index_idle();
         printf("\n==== STUDENT MENU ====\n");
         printf("1. View My Profile\n");
         printf("2. View My Transcript\n");
         printf("3. List Available Courses\n");
+        printf("4. Register for Courses\n");
         printf("0. Logout\n");
         int ch = read_int("Choose: ");
         if (ch == 0)
             break;
+        trace_begin("menu", (ch > 0 && ch < STUDENT_OP_COUNT) ? STUDENT_OPS[ch] : "invalid", NULL);
         if (ch == 1)
         {
-            Student s;
-            if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, u->refId, &s) >= 0)
-                print_student(&s);
-            else
-                printf("Profile not found.\n");
+            student_view_profile(u->refId);
         }
         else if (ch == 2)
         {
-            transcript_for_student(u->refId);
+            student_view_transcript(u->refId);
         }
         else if (ch == 3)
         {
             list_courses();
         }
+        else if (ch == 4)
+        {
+            register_courses(u->refId);
+        }
         else
         {
             printf("Invalid.\n");
         }
+        trace_end();
+    }
+}
+
+/* ======== SERVER MODE ========
+ * `uiu_ums --serve` reads one request per line from stdin (a front end or
+ * a pipe; the pipe is trusted, there is no login) and answers on stdout:
+ *
+ *   enroll SID CODE TERM      transcript SID       (student class)
+ *   grade SID CODE TERM G     roster CODE TERM     (faculty class)
+ *   leaderboard TERM          related CODE TERM    (admin reports)
+ *   export DIR [SID]                               (batch exports)
+ *   stats                                          (answered at once)
+ *
+ * With several campuses on the command line every request names its
+ * campus first, as in "@dhaka roster EEE-2101 Fall-2025"; the worker
+ * switches campus (tenant_activate) before running it.  With one campus
+ * the prefix is optional.
+ *
+ * Each class has its own bounded queue of serve_queue_depth requests.  A
+ * request arriving at a full queue is refused straight away ("busy"), so
+ * the caller backs off instead of waiting without limit.  Queued requests
+ * are picked by weighted fair queuing: every request gets a virtual
+ * finish tag of start + cost / class weight, and the smallest tag runs
+ * next.  A backlog of reports therefore cannot delay an enrollment by more
+ * than about one report's run time.  Input is drained between requests,
+ * so new arrivals are admitted while a backlog is being worked off.  There
+ * is one worker: the process stays single-threaded like the menus.
+ *
+ * Every answer ends with "#SEQ ok|error|busy CMD (wait W ms, run R ms)".
+ */
+enum
+{
+    CLS_STUDENT,
+    CLS_FACULTY,
+    CLS_ADMIN,
+    CLS_BATCH,
+    CLS_COUNT
+};
+
+static const struct
+{
+    const char *name;
+    int weight;
+} SERVE_CLASSES[CLS_COUNT] = {{"student", 8}, {"faculty", 4}, {"admin", 2}, {"batch", 1}};
+
+static const struct
+{
+    const char *cmd;
+    int cls;
+    int cost; // rough run time relative to one enrollment
+    int args; // required arguments
+} SERVE_CMDS[] = {
+    {"enroll", CLS_STUDENT, 1, 3},      {"transcript", CLS_STUDENT, 2, 1}, {"grade", CLS_FACULTY, 1, 4},
+    {"roster", CLS_FACULTY, 2, 2},      {"leaderboard", CLS_ADMIN, 8, 1},  {"related", CLS_ADMIN, 4, 2},
+    {"export", CLS_BATCH, 32, 1},
+};
+#define SERVE_CMD_COUNT (int)(sizeof(SERVE_CMDS) / sizeof(SERVE_CMDS[0]))
+#define SERVE_LINE 256
+#define SERVE_HIST 32 // log2 microsecond latency buckets
+
+typedef struct
+{
+    long seq;
+    int cmd;
+    int campus; // index into g_tenants
+    char line[SERVE_LINE];
+    double arrivalUs;
+    double vfinish; // WFQ virtual finish tag
+} ServeReq;
+
+typedef struct
+{
+    ServeReq *q; // ring of serve_queue_depth slots
+    int head, n;
+    double lastFinish;
+    long served, refused;
+    long hist[SERVE_HIST]; // arrival-to-answer latency
+} ServeClass;
+
+static ServeClass g_serve[CLS_COUNT];
+static double g_serveVtime;
+static long g_serveSeq;
+static int g_serveDepth;
+
+void serve_record(ServeClass *c, double us)
+{
+    int b = 0;
+    while (b + 1 < SERVE_HIST && us >= (double)(2L << b))
+        b++;
+    c->hist[b]++;
+}
+
+/* Upper bound (ms) of the bucket holding quantile q */
+double serve_quantile_ms(const ServeClass *c, double q)
+{
+    long total = 0, seen = 0;
+    for (int b = 0; b < SERVE_HIST; b++)
+        total += c->hist[b];
+    for (int b = 0; b < SERVE_HIST && total; b++)
+    {
+        seen += c->hist[b];
+        if (seen >= q * total)
+            return (double)(2L << b) / 1000.0;
+    }
+    return 0;
+}
+
+void serve_stats()
+{
+    printf("%-8s %6s %8s %7s %8s %8s\n", "class", "weight", "served", "busy", "p50<=ms", "p99<=ms");
+    for (int i = 0; i < CLS_COUNT; i++)
+    {
+        const ServeClass *c = &g_serve[i];
+        printf("%-8s %6d %8ld %7ld %8.2f %8.2f\n", SERVE_CLASSES[i].name, SERVE_CLASSES[i].weight, c->served,
+               c->refused, serve_quantile_ms(c, 0.50), serve_quantile_ms(c, 0.99));
+    }
+}
+
+/* Parse and admit one line; refusals are answered immediately */
+void serve_admit(char *line)
+{
+    char word[16] = "";
+    long seq = ++g_serveSeq;
+    int campus = g_nTenants > 1 ? -1 : 0;
+    if (line[0] == '@')
+    {
+        size_t len = strcspn(line + 1, " \t");
+        campus = -1;
+        for (int i = 0; i < g_nTenants && campus < 0; i++)
+            if (strlen(g_tenants[i].name) == len && strncmp(g_tenants[i].name, line + 1, len) == 0)
+                campus = i;
+        if (campus < 0)
+        {
+            printf("#%ld error (unknown campus %.*s)\n", seq, (int)len, line + 1);
+            return;
+        }
+        line += 1 + len;
+    }
+    if (sscanf(line, "%15s", word) != 1)
+        return;
+    if (strcmp(word, "stats") == 0)
+    {
+        serve_stats();
+        index_stats(); // of the active campus
+        printf("#%ld ok stats\n", seq);
+        return;
+    }
+    if (campus < 0)
+    {
+        printf("#%ld error %s (campus required: @CAMPUS %s ...)\n", seq, word, word);
+        return;
+    }
+    int cmd = -1;
+    for (int i = 0; i < SERVE_CMD_COUNT && cmd < 0; i++)
+        if (strcmp(word, SERVE_CMDS[i].cmd) == 0)
+            cmd = i;
+    if (cmd < 0)
+    {
+        printf("#%ld error %s (unknown command)\n", seq, word);
+        return;
+    }
+    ServeClass *c = &g_serve[SERVE_CMDS[cmd].cls];
+    if (c->n >= g_serveDepth)
+    {
+        c->refused++;
+        printf("#%ld busy %s (%s queue full)\n", seq, word, SERVE_CLASSES[SERVE_CMDS[cmd].cls].name);
+        return;
+    }
+    ServeReq *r = &c->q[(c->head + c->n++) % g_serveDepth];
+    r->seq = seq;
+    r->cmd = cmd;
+    r->campus = campus;
+    snprintf(r->line, sizeof(r->line), "%s", line);
+    r->arrivalUs = now_us();
+    double start = c->lastFinish > g_serveVtime ? c->lastFinish : g_serveVtime;
+    r->vfinish = start + (double)SERVE_CMDS[cmd].cost / SERVE_CLASSES[SERVE_CMDS[cmd].cls].weight;
+    c->lastFinish = r->vfinish;
+}
+
+/* Pending input bytes and whether stdin has ended */
+static char g_serveIn[8192];
+static size_t g_serveInLen;
+static int g_serveEof;
+
+/* Pull what stdin has (waiting for it only when block is set) and admit
+ * every complete line. */
+void serve_ingest(int block)
+{
+#ifdef _WIN32
+    (void)block; // no readiness test for console/pipe stdin: one line per call
+    char line[SERVE_LINE];
+    if (!fgets(line, sizeof(line), stdin))
+    {
+        g_serveEof = 1;
+        return;
+    }
+    line[strcspn(line, "\r\n")] = 0;
+    serve_admit(line);
+#else
+    struct pollfd pfd = {0, POLLIN, 0};
+    if (poll(&pfd, 1, block ? -1 : 0) <= 0)
+        return;
+    ssize_t got = read(0, g_serveIn + g_serveInLen, sizeof(g_serveIn) - 1 - g_serveInLen);
+    if (got <= 0)
+    {
+        g_serveEof = 1;
+        if (g_serveInLen == 0)
+            return;
+        g_serveIn[g_serveInLen++] = '\n'; // admit an unterminated last line
+    }
+    else
+        g_serveInLen += (size_t)got;
+    char *start = g_serveIn, *nl;
+    while ((nl = memchr(start, '\n', g_serveInLen - (size_t)(start - g_serveIn))) != NULL)
+    {
+        *nl = 0;
+        if (nl > start && nl[-1] == '\r')
+            nl[-1] = 0;
+        if (nl - start < SERVE_LINE)
+            serve_admit(start);
+        else
+            printf("#%ld error (line too long)\n", ++g_serveSeq);
+        start = nl + 1;
+    }
+    g_serveInLen -= (size_t)(start - g_serveIn);
+    memmove(g_serveIn, start, g_serveInLen);
+    if (g_serveInLen == sizeof(g_serveIn) - 1)
+    {
+        printf("#%ld error (line too long)\n", ++g_serveSeq);
+        g_serveInLen = 0;
+    }
+#endif
+}
+
+int serve_grade(const char *sid, const char *code, const char *term, char *g)
+{
+    EnrKey key;
+    Enrollment e;
+    snprintf(key.sid, MAX_ID, "%.*s", MAX_ID - 1, sid);
+    snprintf(key.code, MAX_CODE, "%.*s", MAX_CODE - 1, code);
+    snprintf(key.term, MAX_TERM, "%.*s", MAX_TERM - 1, term);
+    upper(g);
+    if (grade_to_points(g) < 0 && strcmp(g, "NA") != 0)
+    {
+        printf("Invalid grade.\n");
+        return 0;
+    }
+    long idx = file_find_first(FILE_ENR, sizeof(Enrollment), pred_enr_by_key, &key, &e);
+    if (idx < 0)
+    {
+        printf("Enrollment not found.\n");
+        return 0;
+    }
+    snprintf(e.grade, sizeof(e.grade), "%.2s", g);
+    if (!file_write_at(FILE_ENR, sizeof(Enrollment), idx, &e))
+        return 0;
+    on_grade_changed(&e);
+    return 1;
+}
+
+int serve_execute(const ServeReq *r)
+{
+    char w[5][SERVE_LINE];
+    int n = sscanf(r->line, "%*s %255s %255s %255s %255s %255s", w[0], w[1], w[2], w[3], w[4]);
+    if (n < SERVE_CMDS[r->cmd].args)
+    {
+        printf("Missing arguments.\n");
+        return 0;
+    }
+    switch (r->cmd)
+    {
+    case 0:
+    {
+        Cart c = {0};
+        snprintf(c.sid, sizeof(c.sid), "%.*s", MAX_ID - 1, w[0]);
+        snprintf(c.term, sizeof(c.term), "%.*s", MAX_TERM - 1, w[2]);
+        cart_add(&c, w[1]);
+        if (file_find_first(FILE_STUD, sizeof(Student), pred_student_by_id, c.sid, NULL) < 0)
+        {
+            printf("Student not found.\n");
+            return 0;
+        }
+        if (cart_commit(&c))
+            return 1;
+        printf("Cannot enroll: %s.\n", c.status[0] != CART_OK ? CART_STATUS[c.status[0]] : "write error");
+        return 0;
+    }
+    case 1:
+        student_view_transcript(w[0]);
+        return 1;
+    case 2:
+        return serve_grade(w[0], w[1], w[2], w[3]);
+    case 3:
+        roster_for_course_term(w[0], w[1]);
+        return 1;
+    case 4:
+        gpa_leaderboard(w[0]);
+        return 1;
+    case 5:
+        related_courses(w[0], w[1], 5);
+        return 1;
+    case 6:
+        export_transcripts(w[0], n > 1 ? w[1] : "", EXPORT_HTML | EXPORT_PDF);
+        return 1;
+    }
+    return 0;
+}
+
+long serve_mem_usage()
+{
+    return g_serveDepth * CLS_COUNT * (long)sizeof(ServeReq) + (long)sizeof(g_serveIn);
+}
+
+/* Head of the class queue with the smallest virtual finish tag */
+ServeReq *serve_pick(ServeClass **from)
+{
+    ServeReq *best = NULL;
+    for (int i = 0; i < CLS_COUNT; i++)
+    {
+        ServeClass *c = &g_serve[i];
+        if (c->n && (!best || c->q[c->head].vfinish < best->vfinish))
+        {
+            best = &c->q[c->head];
+            *from = c;
+        }
+    }
+    return best;
+}
+
+void serve_main()
+{
+    g_serveDepth = (int)g_cfg.serveQueueDepth;
+    for (int i = 0; i < CLS_COUNT; i++)
+        if (!(g_serve[i].q = (ServeReq *)malloc((size_t)g_serveDepth * sizeof(ServeReq))))
+        {
+            printf("Out of memory for request queues.\n");
+            return;
+        }
+    for (int i = g_nTenants - 1; i >= 0; i--) // ends with the first campus active
+    {
+        tenant_activate(&g_tenants[i]);
+        bootstrap_if_empty();
+    }
+    printf("Serving");
+    for (int i = 0; i < g_nTenants; i++)
+        printf(" %s", g_tenants[i].name);
+    printf(" (queue depth %d per class)\n", g_serveDepth);
+    fflush(stdout);
+    while (1)
+    {
+        config_poll();
+        tenant_housekeeping();
+        mem_enforce();
+        ServeClass *c = NULL;
+        ServeReq *r = serve_pick(&c);
+        if (!r && g_serveEof)
+            break;
+        int busy = 0;
+        if (!r)
+        {
+            snapshot_flush(SNAP_FLUSH_BATCH); // idle: catch up before blocking
+            busy = index_idle();
+        }
+        if (!g_serveEof)
+            serve_ingest(r == NULL && g_snapDirtyN == 0 && !busy); // nothing to do: wait for input
+        r = serve_pick(&c);
+        if (!r)
+            continue;
+        ServeReq req = *r; // the slot may be reused by admissions during the run
+        c->head = (c->head + 1) % g_serveDepth;
+        c->n--;
+        g_serveVtime = req.vfinish;
+        double t0 = now_us();
+        tenant_activate(&g_tenants[req.campus]); // counts as run time: a switch flushes and swaps state
+        trace_begin("serve", SERVE_CMDS[req.cmd].cmd, "seq=%ld class=%s", req.seq,
+                    SERVE_CLASSES[SERVE_CMDS[req.cmd].cls].name);
+        int ok = serve_execute(&req);
+        trace_end();
+        double t1 = now_us();
+        c->served++;
+        serve_record(c, t1 - req.arrivalUs);
+        printf("#%ld %s %s (wait %.2f ms, run %.2f ms)\n", req.seq, ok ? "ok" : "error", SERVE_CMDS[req.cmd].cmd,
+               (t0 - req.arrivalUs) / 1000.0, (t1 - t0) / 1000.0);
+        fflush(stdout);
+        index_idle(); // one bounded step, so a server that is never idle still gets its indexes
+    }
+    snapshot_flush(-1);
+    if (g_adj.dirty)
+        adj_save(&g_adj);
+    if (g_zones.dirty)
+        zone_save(&g_zones);
+    serve_stats();
+    for (int i = 0; i < CLS_COUNT; i++)
+        free(g_serve[i].q);
+}
+
+#ifdef FUZZ
+/* ======== FUZZ TARGETS ========
+ * libFuzzer entry points for everything that reads bytes the program did
+ * not just write itself.  One target per build, chosen with -DFUZZ=...:
+ *
+ *   FUZZ_LZ      archive block decoder; decodable input is round-tripped
+ *                through the encoder
+ *   FUZZ_SEG     a whole archive/<term>.seg file through seg_read
+ *   FUZZ_ADJ     enrollments.adj through adj_load
+ *   FUZZ_CONFIG  uiu_ums.conf through config_load
+ *   FUZZ_CSV     bulk import lines through bulk_line; the first byte picks
+ *                the kind (students, enrollments, grades, learners)
+ *
+ * File readers get the input as the file itself, inside a scratch campus
+ * folder under /tmp.  Build with make -C tests fuzz (clang, libFuzzer,
+ * ASan + UBSan) or fuzz-replay (any compiler, see tests/fuzz/replay.c).
+ * Without FUZZ none of this is compiled and main() is the program's.
+ */
+#define FUZZ_LZ 1
+#define FUZZ_SEG 2
+#define FUZZ_ADJ 3
+#define FUZZ_CONFIG 4
+#define FUZZ_CSV 5
+#define FUZZ_TERM "FUZZ-TERM"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/* Scratch campus for the file readers, made on first use */
+void fuzz_init()
+{
+    static char root[] = "/tmp/uiu_fuzz.XXXXXX";
+    if (g_tenant)
+        return;
+    if (!mkdtemp(root))
+        abort();
+    tenant_add(root);
+    tenant_activate(&g_tenants[0]);
+    MKDIR(FILE_ARCHIVE);
+}
+
+void fuzz_write(const char *path, const uint8_t *data, size_t size)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp || fwrite(data, 1, size, fp) != size || fclose(fp) != 0)
+        abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    fuzz_init();
+#if FUZZ == FUZZ_LZ
+    static unsigned char out[1 << 16], again[1 << 16], comp[(1 << 16) + (1 << 16) / 255 + 16];
+    size_t n = lz_decompress(data, size, out, sizeof(out));
+    if (n != (size_t)-1)
+    {
+        size_t c = lz_compress(out, n, comp, sizeof(comp));
+        if (c == 0 && n > 0)
+            abort(); // the encoder must always fit its worst case
+        if (lz_decompress(comp, c, again, sizeof(again)) != n || memcmp(out, again, n) != 0)
+            abort();
+    }
+#elif FUZZ == FUZZ_SEG
+    char path[MAX_PATH_LEN + 48];
+    archive_seg_path(FUZZ_TERM, path, sizeof(path));
+    fuzz_write(path, data, size);
+    const char *sids[2] = {NULL, "02124100001"};
+    for (int i = 0; i < 2; i++)
+    {
+        Enrollment *rows = NULL;
+        long n = 0, cap = 0;
+        seg_read(FUZZ_TERM, sids[i], &rows, &n, &cap);
+        free(rows);
     }
+#elif FUZZ == FUZZ_ADJ
+    fuzz_write(FILE_ADJ, data, size);
+    int32_t n = 0;
+    if (size >= 12)
+        memcpy(&n, data + 8, sizeof(n)); // the record count the file claims
+    EnrAdj a;
+    memset(&a, 0, sizeof(a));
+    if (n >= 0 && n <= 1 << 16) // adj_load trusts only the real count; keep it sane here
+        adj_load(&a, n);
+    adj_list_free(&a.byStudent);
+    adj_list_free(&a.byCourse);
+#elif FUZZ == FUZZ_CONFIG
+    char path[MAX_PATH_LEN + 16];
+    snprintf(path, sizeof(path), "%s/fuzz.conf", g_tenant->root);
+    fuzz_write(path, data, size);
+    Config c = g_cfg;
+    config_load(&c, path);
+#elif FUZZ == FUZZ_CSV
+    if (size == 0)
+        return 0;
+    char path[MAX_PATH_LEN + 16];
+    snprintf(path, sizeof(path), "%s/fuzz.csv", g_tenant->root);
+    fuzz_write(path, data + 1, size - 1); // learners pre-scan the file itself
+    BulkCtx c;
+    memset(&c, 0, sizeof(c));
+    c.kind = &BULK_KINDS[data[0] % BULK_KIND_COUNT];
+    c.input = path;
+    c.opts = "CSE|241|L";
+    c.stu = (Student *)malloc(64 * sizeof(Student));
+    c.enr = (Enrollment *)malloc(64 * sizeof(Enrollment));
+    FILE *in = fopen(path, "rb");
+    char line[BULK_LINE], key[BULK_KEY];
+    int ok = in && c.stu && c.enr && c.kind->prepare(&c);
+    while (ok && fgets(line, sizeof(line), in))
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        c.line++;
+        bulk_line(&c, line, key);
+        if (c.nStu >= 64 || c.nEnr >= 64)
+            c.nStu = c.nEnr = 0; // bulk_run commits a full batch; the fuzzer drops it
+    }
+    if (in)
+        fclose(in);
+    free(c.stu);
+    free(c.enr);
+    free(c.sids);
+    free(c.cs);
+    free(c.last);
+    keyset_free(&c.keys);
+#else
+#error unknown FUZZ target
+#endif
+    return 0;
 }
+#endif
 
 /* ======== MAIN ======== */
-int main()
+#ifndef FUZZ // fuzz builds get main() from libFuzzer
+int main(int argc, char **argv)
 {
     printf("UIU University Management System (UMS)\n");
-    printf("Storage: binary files in current folder\n");
-    bootstrap_if_empty();
+    config_init(&argc, argv);
+    int serve = argc > 1 && strcmp(argv[1], "--serve") == 0;
+    if (serve)
+    {
+        for (int i = 1; i + 1 < argc; i++)
+            argv[i] = argv[i + 1];
+        argc--;
+    }
+    for (int i = 1; i < argc; i++)
+        if (!tenant_add(argv[i]))
+            printf("Too many campuses, ignoring %s\n", argv[i]);
+    if (g_nTenants == 0)
+    {
+        char spec[MAX_PATH_LEN];
+        snprintf(spec, sizeof(spec), "default=%s", g_cfg.dataDir);
+        tenant_add(spec);
+    }
+    if (g_nTenants == 1 && strcmp(g_tenants[0].root, ".") == 0)
+        printf("Storage: binary files in current folder\n");
+    else
+        for (int i = 0; i < g_nTenants; i++)
+            printf("Campus %s: %s\n", g_tenants[i].name, g_tenants[i].root);
+    if (serve)
+    {
+        serve_main();
+        return 0;
+    }
 
     while (1)
     {
+        config_poll();
+        tenant_housekeeping();
+        mem_enforce();
+        if (!tenant_select())
+        {
+            pause_enter();
+            continue;
+        }
+        bootstrap_if_empty();
         Session s = login();
         if (!s.logged)
         {
@@ -1037,10 +7131,16 @@ int main()
             menu_student(&s.user);
         else
             printf("Unknown role.\n");
+        snapshot_flush(-1);
+        if (g_adj.dirty)
+            adj_save(&g_adj);
+        if (g_zones.dirty)
+            zone_save(&g_zones);
         printf("Logged out.\n\n");
     }
     return 0;
 }
+#endif
 
 // '''
 
@@ -1099,7 +7199,7 @@ int main()
 // ------------
 // - Storage is in simple binary files to keep the code compact.
 // - Passwords are only *obfuscated* (XOR + salt). For real systems, replace with a secure hash.
-// - Grading scale uses a standard 4.0 system (A to F, with +/-). Adjust in grade_to_points().
+// - Grading scale uses a standard 4.0 system (A to F, with +/-). Adjust in GRADE_SCALE.
 
 // Customization
 // -------------